@@ -0,0 +1,59 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_BATCH_ENCRYPTOR_H_
+#define MAIDSAFE_ENCRYPT_BATCH_ENCRYPTOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/data_buffer.h"
+
+#include "maidsafe/encrypt/data_map.h"
+#include "maidsafe/encrypt/executor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Reads the next bytes of a file, up to "length" of them, into "data" and returns how many were
+// read.  Fewer than "length" means the end of the file was reached.  It may throw to abandon the
+// batch.
+using FileReader = std::function<uint32_t(char* data, uint32_t length)>;
+
+// Self-encrypts each file read through "readers" as a separate file, storing the chunks in
+// "buffer", and returns their DataMaps in the same order.  Each file is read a chunk at a time,
+// written and closed as a task on "executor" (or on DefaultExecutor() if it is empty), with its
+// chunks encrypted in the background as the reading moves past them.  The hashing and encryption
+// of its chunks are queued as further tasks there, so that all the files share the same threads:
+// many small files keep every thread busy, while the chunks of a large one are interleaved with the
+// work of the others.  Only the files currently being encrypted are held in memory.
+std::vector<DataMap> EncryptFiles(const std::vector<FileReader>& readers, DataBuffer& buffer,
+                                  const Executor& executor = Executor());
+// As above, reading each file from disk
+std::vector<DataMap> EncryptFiles(const std::vector<boost::filesystem::path>& paths,
+                                  DataBuffer& buffer, const Executor& executor = Executor());
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_BATCH_ENCRYPTOR_H_
@@ -0,0 +1,90 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_COMPRESSION_POLICY_H_
+#define MAIDSAFE_ENCRYPT_COMPRESSION_POLICY_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Chooses the deflate level for each chunk a SelfEncryptor compresses with gzip.  It may be shared
+// by several SelfEncryptors writing to the same store, and is safe to use from any thread.
+//
+// A fixed policy always uses the same level.  Self-encryption is convergent, so the same content
+// only produces the same chunks if it's compressed at the same level; the default, level 1, is the
+// level all earlier chunks were written at.
+//
+// An adaptive policy trades deduplication for throughput: it measures each level's speed and ratio
+// as chunks are compressed, and moves a level at a time towards whichever gives the greatest
+// throughput.  That is the lesser of the rate "concurrency" threads compress plaintext at, and the
+// rate the store can absorb plaintext at given "store_bandwidth" (bytes of encrypted chunks per
+// second) and the level's ratio.  So the level climbs while the store is the bottleneck and cores
+// have time to spare, and falls back towards the fastest level when the cores are the bottleneck,
+// including when other work slows compression down.
+class CompressionPolicy {
+ public:
+  enum : int { kFastestLevel = 1, kBestLevel = 9 };
+
+  explicit CompressionPolicy(int level = kFastestLevel);
+  CompressionPolicy(uint64_t store_bandwidth, unsigned concurrency);
+  CompressionPolicy(const CompressionPolicy&) = delete;
+  CompressionPolicy(CompressionPolicy&&) = delete;
+  CompressionPolicy& operator=(CompressionPolicy) = delete;
+
+  bool adaptive() const { return kAdaptive_; }
+  // The level to compress the next chunk at
+  int Level() const;
+  // Records that compressing "input_size" bytes at "level" took "duration" and gave "output_size"
+  // bytes
+  void Record(int level, uint64_t input_size, uint64_t output_size,
+              std::chrono::nanoseconds duration);
+
+ private:
+  struct Measurement {
+    Measurement() : valid(false), speed(0.0), ratio(1.0) {}
+    bool valid;
+    double speed;  // bytes per second per thread
+    double ratio;  // output size / input size
+  };
+
+  // Estimated plaintext throughput at "level", which must have been measured
+  double Throughput(int level) const;
+  // True if moving to "level" isn't known to reduce throughput.  Forgets "level"'s measurement if
+  // it has been relied on for too long.
+  bool WorthTrying(int level);
+
+  const bool kAdaptive_;
+  const double kStoreBandwidth_, kConcurrency_;
+  std::array<Measurement, kBestLevel + 1> measurements_;
+  int level_;
+  unsigned samples_;  // measured at level_ since the last decision
+  unsigned stays_;    // decisions since the level last changed
+  mutable std::mutex mutex_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_COMPRESSION_POLICY_H_
@@ -19,12 +19,17 @@
 #ifndef MAIDSAFE_ENCRYPT_DATA_MAP_H_
 #define MAIDSAFE_ENCRYPT_DATA_MAP_H_
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstdint>
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include "maidsafe/common/config.h"
 #include "maidsafe/common/crypto.h"
+#include "maidsafe/common/error.h"
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/serialisation/serialisation.h"
 
@@ -36,29 +41,97 @@ using ByteVector = std::vector<byte>;
 
 enum class EncryptionAlgorithm : uint32_t {
   kSelfEncryptionVersion0 = 0,
-  kDataMapEncryptionVersion0
+  kDataMapEncryptionVersion0,
+  kSelfEncryptionVersion1,
+  kSelfEncryptionVersion2
 };
 
+// How chunk contents are compressed before being encrypted.  Self-encryption versions 0 and 1
+// always use kGzip; from version 2 the DataMap records which is used.
+enum class ChunkCompression : uint32_t {
+  kGzip = 0,
+  kLz4
+};
+
+// Inline storage for a chunk's 64-byte hash or pre-hash, which is either empty or full.  This keeps
+// ChunkDetails free of heap allocations, so that large DataMaps are a single contiguous array.
+// It is serialised in the same form as a ByteVector.
+class ChunkDigest {
+ public:
+  ChunkDigest() : bytes_(), full_(false) {}
+
+  template <typename Iterator>
+  void assign(Iterator first, Iterator last) {
+    if (first == last) {
+      clear();
+      return;
+    }
+    assert(std::distance(first, last) == crypto::SHA512::DIGESTSIZE);
+    std::copy(first, last, std::begin(bytes_));
+    full_ = true;
+  }
+  void clear() { full_ = false; }
+  bool empty() const { return !full_; }
+  size_t size() const { return full_ ? bytes_.size() : 0; }
+  const byte* data() const { return bytes_.data(); }
+  const byte* begin() const { return bytes_.data(); }
+  const byte* end() const { return bytes_.data() + size(); }
+  byte operator[](size_t index) const { return bytes_[index]; }
+
+ private:
+  std::array<byte, crypto::SHA512::DIGESTSIZE> bytes_;
+  bool full_;
+};
+
+inline bool operator==(const ChunkDigest& lhs, const ChunkDigest& rhs) {
+  return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool operator!=(const ChunkDigest& lhs, const ChunkDigest& rhs) { return !(lhs == rhs); }
+
 struct ChunkDetails {
-  enum StorageState { kStored, kPending, kUnstored };
-  ChunkDetails() : hash(), pre_hash(), storage_state(kUnstored), size(0) {}
-  ChunkDetails(const ChunkDetails&) = default;
-  ChunkDetails(ChunkDetails&&) MAIDSAFE_NOEXCEPT;
-  ChunkDetails& operator=(const ChunkDetails&) = default;
-  ChunkDetails& operator=(ChunkDetails&& other) MAIDSAFE_NOEXCEPT;
-  ~ChunkDetails() = default;
+  enum StorageState : uint8_t { kStored, kPending, kUnstored };
+  ChunkDetails() : hash(), pre_hash(), storage_state(kUnstored), size(0), compressed(true) {}
 
   template <typename Archive>
-  Archive& serialize(Archive& archive) {
-    return archive(hash, pre_hash, storage_state, size);
+  void save(Archive& archive) const {
+    ByteVector& buffer(SerialisationBuffer());
+    buffer.assign(hash.begin(), hash.end());
+    archive(buffer);
+    buffer.assign(pre_hash.begin(), pre_hash.end());
+    uint32_t state(static_cast<uint32_t>(storage_state) | (compressed ? 0U : kUncompressedFlag));
+    archive(buffer, state, size);
   }
 
-  ByteVector hash;      // SHA512 of processed chunk
-  ByteVector pre_hash;  // SHA512 of unprocessed src data
-  // pre hashes of chunks n-1 and n-2, only valid if chunk n-1 or n-2 has
-  // modified content
+  template <typename Archive>
+  void load(Archive& archive) {
+    ByteVector& buffer(SerialisationBuffer());
+    archive(buffer);
+    LoadDigest(buffer, hash);
+    archive(buffer);
+    LoadDigest(buffer, pre_hash);
+    uint32_t state(0);
+    archive(state, size);
+    compressed = (state & kUncompressedFlag) == 0;
+    state &= ~static_cast<uint32_t>(kUncompressedFlag);
+    if (state > kUnstored)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+    storage_state = static_cast<StorageState>(state);
+  }
+
+  ChunkDigest hash;      // SHA512 of processed chunk
+  ChunkDigest pre_hash;  // SHA512 of unprocessed src data
   StorageState storage_state;
   uint32_t size;  // Size of unprocessed source data in bytes
+  bool compressed;  // false if, from version 2, the data looked incompressible so wasn't compressed
+
+ private:
+  // Serialised as part of the storage state, so that compressed chunks keep their original form
+  enum : uint32_t { kUncompressedFlag = 0x100 };
+
+  // Reused while (de)serialising so that the digests can be written in ByteVector form
+  static ByteVector& SerialisationBuffer();
+  static void LoadDigest(const ByteVector& buffer, ChunkDigest& digest);
 };
 
 struct DataMap {
@@ -72,13 +145,35 @@ struct DataMap {
   bool empty() const;
 
   template <typename Archive>
-  Archive& serialize(Archive& archive) {
-    return archive(self_encryption_version, chunks, content);
+  void save(Archive& archive) const {
+    archive(self_encryption_version, chunks, content);
+    if (RecordsCompression())
+      archive(compression);
+  }
+
+  template <typename Archive>
+  void load(Archive& archive) {
+    archive(self_encryption_version, chunks, content);
+    compression = ChunkCompression::kGzip;
+    if (RecordsCompression()) {
+      archive(compression);
+    } else if (std::any_of(chunks.begin(), chunks.end(),
+                           [](const ChunkDetails& chunk) { return !chunk.compressed; })) {
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+    }
   }
 
   EncryptionAlgorithm self_encryption_version;
+  ChunkCompression compression;
   std::vector<ChunkDetails> chunks;
   ByteVector content;  // Whole data item, if small enough
+
+ private:
+  // Earlier versions' maps are serialised without "compression", and always compress every chunk
+  bool RecordsCompression() const {
+    return self_encryption_version != EncryptionAlgorithm::kSelfEncryptionVersion0 &&
+           self_encryption_version != EncryptionAlgorithm::kSelfEncryptionVersion1;
+  }
 };
 
 bool operator==(const DataMap& lhs, const DataMap& rhs);
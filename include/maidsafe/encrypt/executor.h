@@ -0,0 +1,41 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_EXECUTOR_H_
+#define MAIDSAFE_ENCRYPT_EXECUTOR_H_
+
+#include <functional>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Runs "task" at some later point, possibly on another thread.  An Executor may also run the task
+// before returning.  SelfEncryptors run all their hashing, encryption and decryption work through
+// one of these.
+using Executor = std::function<void(std::function<void()> task)>;
+
+// An Executor backed by a process-wide pool holding one thread per core, which is shared by all
+// SelfEncryptors not given an Executor of their own.
+Executor DefaultExecutor();
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_EXECUTOR_H_
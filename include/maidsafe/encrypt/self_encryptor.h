@@ -19,7 +19,10 @@
 #ifndef MAIDSAFE_ENCRYPT_SELF_ENCRYPTOR_H_
 #define MAIDSAFE_ENCRYPT_SELF_ENCRYPTOR_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -27,38 +30,98 @@
 #include <array>
 #include <vector>
 #include <deque>
-#include <map>
+#include <set>
 #include <utility>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/thread/shared_mutex.hpp"
+
 #include "maidsafe/common/crypto.h"
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/data_buffer.h"
 
+#include "maidsafe/encrypt/compression_policy.h"
 #include "maidsafe/encrypt/data_map.h"
+#include "maidsafe/encrypt/executor.h"
 
 namespace maidsafe {
 
 namespace encrypt {
+class Buffer;
+class BufferPool;
 class Cache;
+class ChunkStatusTable;
+struct ChunkKeys;
+struct EncodedChunk;
+class PreHashTracker;
+class Sequencer;
+class TaskGroup;
 namespace test {
 class PrivateSelfEncryptorTest;
 }
 
+// Default cap on the plaintext held in memory by each SelfEncryptor
+const uint64_t kDefaultMaxMemoryUsage(256 * 1024 * 1024);
+
+// Reports the outcome of retrieving the chunk at position "index" of a batch.  "error" is null if
+// "content" holds the chunk.
+using ChunkRetrieved =
+    std::function<void(size_t index, std::exception_ptr error, NonEmptyString content)>;
+// Starts retrieving a batch of chunks by name.  It must not throw, and must call "on_retrieved"
+// exactly once for each name, from any thread, in any order and either before or after returning.
+using GetChunksFromStore =
+    std::function<void(const std::vector<std::string>& names, ChunkRetrieved on_retrieved)>;
+
 class SelfEncryptor {
  public:
+  // Once more than "max_memory_usage" bytes of plaintext are held, chunks outside the current
+  // read/write window are encrypted and released from memory.  If "spill_directory" is not empty,
+  // the plaintext is instead held in a temporary memory-mapped file there, which the OS pages out
+  // as needed, so chunks are only encrypted on Close.
+  // Hashing, encryption and decryption run on "executor", or on DefaultExecutor() if it is empty.
   SelfEncryptor(DataMap& data_map, DataBuffer& buffer,
-                std::function<NonEmptyString(const std::string&)> get_from_store);
+                std::function<NonEmptyString(const std::string&)> get_from_store,
+                MemoryUsage max_memory_usage = MemoryUsage(kDefaultMaxMemoryUsage),
+                const boost::filesystem::path& spill_directory = boost::filesystem::path(),
+                const Executor& executor = Executor());
+  // As above, but with chunks retrieved asynchronously, each window of chunks as a single batch
+  SelfEncryptor(DataMap& data_map, DataBuffer& buffer, GetChunksFromStore get_chunks_from_store,
+                MemoryUsage max_memory_usage = MemoryUsage(kDefaultMaxMemoryUsage),
+                const boost::filesystem::path& spill_directory = boost::filesystem::path(),
+                const Executor& executor = Executor());
   ~SelfEncryptor();
   SelfEncryptor(const SelfEncryptor&) = delete;
   SelfEncryptor(SelfEncryptor&&) = delete;
   SelfEncryptor& operator=(SelfEncryptor) = delete;
 
+  // A single buffer of a scatter-gather list, laid out like POSIX iovec
+  struct ConstSpan {
+    const char* data;
+    uint32_t length;
+  };
+  struct MutableSpan {
+    char* data;
+    uint32_t length;
+  };
+
   bool Write(const char* data, uint32_t length, uint64_t position);
+  // Safe to call concurrently with other reads, which run in parallel where the data is in memory
   bool Read(char* data, uint32_t length, uint64_t position);
+  // Equivalent to writing or reading each of the "count" spans in turn at consecutive positions
+  // starting from "position", but copying directly between the spans and the file contents.
+  bool WriteV(const ConstSpan* spans, size_t count, uint64_t position);
+  bool ReadV(const MutableSpan* spans, size_t count, uint64_t position);
   // Can truncate up or down
   bool Truncate(uint64_t position);
   // Forces all buffered data to be encrypted.  Missing portions of the file are filled with '\0's
   void Close();
   bool Flush();
+  // If enabled, chunks which writes have moved beyond are encrypted and stored in the background
+  // rather than all being left until Close.  This suits files written roughly sequentially.
+  void SetBackgroundEncryption(bool enable);
+  // Replaces the policy choosing the deflate level of chunks compressed with gzip, which by default
+  // uses level 1 throughout
+  void SetCompressionPolicy(std::shared_ptr<CompressionPolicy> policy);
   uint64_t size() const { return file_size_; }
   const DataMap& data_map() const { return data_map_; }
   const DataMap& original_data_map() const { return kOriginalDataMap_; }
@@ -66,16 +129,79 @@ class SelfEncryptor {
   friend class test::PrivateSelfEncryptorTest;
 
  private:
-  // read in all data and up to next 2 chunks
+  // Exactly one of "get_from_store" and "get_chunks_from_store" is set
+  SelfEncryptor(DataMap& data_map, DataBuffer& buffer,
+                std::function<NonEmptyString(const std::string&)> get_from_store,
+                GetChunksFromStore get_chunks_from_store, MemoryUsage max_memory_usage,
+                const boost::filesystem::path& spill_directory, const Executor& executor);
+  // read in all data, and up to next 2 chunks when writing
   void PrepareWindow(uint32_t length, uint64_t position, bool write);
-  // Retrieves the encrypted chunk from chunk_store_ and decrypts it to "data".
-  ByteVector DecryptChunk(uint32_t chunk_num);
+  // Sets file_size_, first reading in any chunks whose boundaries move as a result
+  void Resize(uint64_t new_size);
+  // Decrypts the given remote chunks into sequencer_
+  void LoadChunks(const std::vector<uint32_t>& chunk_nums);
+  // Queues the loading of the given chunks on "tasks".  Speculative loads mark each chunk as
+  // stored, or as remote again if it fails to load, rather than throwing.
+  void StartLoading(const std::vector<uint32_t>& chunk_nums, TaskGroup& tasks, bool speculative);
+  // Starts loading in the background any remote chunks among the "count" from "first_chunk"
+  void ReadAhead(uint32_t first_chunk, uint32_t count);
+  // Records a read, returning how many chunks beyond it to read ahead; none unless the reads are
+  // sequential
+  uint32_t ReadAheadChunks(uint64_t position, uint64_t length);
+  // True if any of the "count" chunks following "position" is remote
+  bool NeedsReadAhead(uint64_t position, uint32_t count) const;
+  // Encrypts and drops chunks outside [window_begin, window_end) until sequencer_ plus "reserve"
+  // fits within kMaxMemoryUsage_, unless sequencer_ is spilling.  Chunks 0 and 1 and the last two
+  // chunks are always kept.
+  void ReleaseMemory(uint32_t window_begin, uint32_t window_end, uint64_t reserve);
+  void ReleaseChunk(uint32_t chunk_num);
+  // Hashes the chunk and chunks n-1 and n-2 where their pre-hashes are out of date
+  void HashWithPredecessors(uint32_t chunk_num);
+  // Starts background encryption of any modified chunks in [first_chunk, end_chunk), other than
+  // chunks 0 and 1 and the last two
+  void EncryptInBackground(uint32_t first_chunk, uint32_t end_chunk);
+  // Waits for all background encryption and reading ahead to finish
+  void WaitForBackground();
+  // Waits for any chunks in [first_chunk, end_chunk) being read ahead
+  void WaitForLoads(uint32_t first_chunk, uint32_t end_chunk);
+  // True if all chunks covering [position, position + length) are held in sequencer_
+  bool IsResident(uint64_t position, uint64_t length) const;
+  // True if any chunk in [first_chunk, end_chunk) may still be being encrypted or loaded in the
+  // background
+  bool InBackground(uint32_t first_chunk, uint32_t end_chunk) const;
+  // Feeds the written data to pre_hashes_, a chunk at a time
+  void TrackPreHashes(const byte* data, uint32_t length, uint64_t position);
+  // Records the pre-hashes accumulated by pre_hashes_ for any of the chunks, returning the others
+  std::vector<uint32_t> TakeTrackedPreHashes(const std::vector<uint32_t>& chunk_nums);
+  // Calculates the pre-hashes of the chunks as currently held in sequencer_, in parallel batches
+  void HashChunks(const std::vector<uint32_t>& chunk_nums);
+  // As HashChunks for the "count" chunks, in a single batch on the calling thread
+  void HashChunkGroup(const uint32_t* chunk_nums, size_t count);
+  // True if the chunk is a hole whose pre-hash matches those of chunks n-1 and n-2, so that its
+  // encrypted content is the same as that of every other such chunk
+  bool IsZeroChunk(uint32_t chunk_num) const;
+  Buffer GetChunkData(uint32_t chunk_num) const;
+  // Retrieves the encrypted chunk using get_from_store_
+  NonEmptyString FetchChunk(uint32_t chunk_num) const;
+  // Decrypts the retrieved chunk
+  Buffer DecryptChunk(uint32_t chunk_num, const NonEmptyString& content);
   // Retrieves appropriate pre-hashes from data_map_ and constructs key, IV and
   // encryption pad.
-  void GetPadIvKey(uint32_t this_chunk_num, ByteVector& key, ByteVector& iv, ByteVector& pad);
-  // Encrypts the chunk and stores in chunk_store_
-  void EncryptChunk(uint32_t chunk_num, ByteVector data, uint32_t length);
+  void GetPadIvKey(uint32_t this_chunk_num, ChunkKeys& keys) const;
+  // Encrypts the chunk and stores in chunk_store_.  "data" is returned to buffer_pool_.
+  void EncryptChunk(uint32_t chunk_num, Buffer data, uint32_t length);
+  // As EncryptChunk for each chunk as held in sequencer_, but with the encrypted contents hashed
+  // together in one batch.  "keys" holds each chunk's keys, in the same order.
+  void EncryptChunks(const std::vector<uint32_t>& chunk_nums, const ChunkKeys* keys);
+  // Returns the contents of the chunk encrypted with "keys".  "data" is returned to buffer_pool_.
+  EncodedChunk EncodeChunkData(uint32_t chunk_num, Buffer data, uint32_t length,
+                               const ChunkKeys& keys);
+  // Stores the encrypted chunk under "name" and records it in data_map_
+  void StoreChunk(uint32_t chunk_num, EncodedChunk encoded, const byte* name, uint32_t length);
   void CleanUpAfterException() {
+    try {
+      WaitForBackground();
+    } catch (const std::exception&) {}
     std::swap(data_map_, kOriginalDataMap_);
     assert(false && "cleaned up after exception");
   }
@@ -90,21 +216,27 @@ class SelfEncryptor {
   uint32_t GetChunkNumber(uint64_t position) const;
   // ########end of helpers#########################################################
 
-  enum class ChunkStatus {
-    to_be_hashed,
-    to_be_encrypted,
-    stored,  // therefor only being used as read cache`
-    remote
-  };
-
   DataMap& data_map_, kOriginalDataMap_;
-  std::vector<byte> sequencer_;
-  std::map<uint32_t, ChunkStatus> chunks_;
+  std::unique_ptr<Sequencer> sequencer_;
+  BufferPool& buffer_pool_;
+  std::unique_ptr<ChunkStatusTable> chunks_;
+  std::unique_ptr<PreHashTracker> pre_hashes_;
+  std::shared_ptr<CompressionPolicy> compression_policy_;
   DataBuffer& buffer_;
   std::function<NonEmptyString(const std::string&)> get_from_store_;
-  uint64_t file_size_;
-  bool closed_;
+  GetChunksFromStore get_chunks_from_store_;
+  const Executor executor_;
+  const uint64_t kMaxMemoryUsage_;
+  std::atomic<uint64_t> file_size_;
+  bool closed_, background_encryption_;
+  std::atomic<uint64_t> next_read_position_, sequential_read_length_;
+  // Held exclusively by all public functions, other than Read when IsResident
+  mutable boost::shared_mutex mutex_;
   mutable std::mutex data_mutex_;
+  std::set<uint32_t> background_chunks_;
+  // notified under data_mutex_ as each chunk being read ahead finishes loading
+  std::condition_variable loads_done_;
+  std::unique_ptr<TaskGroup> background_;
 };
 
 }  // namespace encrypt
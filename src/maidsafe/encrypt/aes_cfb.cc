@@ -0,0 +1,354 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/aes_cfb.h"
+
+#include <cassert>
+#include <cstring>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/aes.h"
+#include "cryptopp/modes.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAIDSAFE_ENCRYPT_AES_NI 1
+#define MAIDSAFE_ENCRYPT_AES_TARGET(target_list) __attribute__((target(target_list)))
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define MAIDSAFE_ENCRYPT_AES_NI 1
+#define MAIDSAFE_ENCRYPT_AES_TARGET(target_list)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+const int kRounds(14);
+
+#ifdef MAIDSAFE_ENCRYPT_AES_NI
+
+void Cpuid(int leaf, int subleaf, unsigned int info[4]) {
+#ifdef __GNUC__
+  if (!__get_cpuid_count(leaf, subleaf, &info[0], &info[1], &info[2], &info[3]))
+    info[0] = info[1] = info[2] = info[3] = 0;
+#else
+  __cpuidex(reinterpret_cast<int*>(info), leaf, subleaf);
+#endif
+}
+
+uint64_t EnabledStateComponents() {
+#ifdef __GNUC__
+  uint32_t low, high;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return (static_cast<uint64_t>(high) << 32) | low;
+#else
+  return _xgetbv(0);
+#endif
+}
+
+AesImplementation DetectImplementation() {
+  unsigned int info[4];
+  Cpuid(0, 0, info);
+  const unsigned int kMaxLeaf(info[0]);
+  Cpuid(1, 0, info);
+  const unsigned int kAesNi(1u << 25), kOsxsave(1u << 27), kAvx(1u << 28);
+  if ((info[2] & kAesNi) == 0)
+    return AesImplementation::kPortable;
+  // VAES also needs AVX2 for the 256-bit loads and XORs, and the OS to save the YMM registers
+  if (kMaxLeaf < 7 || (info[2] & (kOsxsave | kAvx)) != (kOsxsave | kAvx) ||
+      (EnabledStateComponents() & 6) != 6) {
+    return AesImplementation::kAesNi;
+  }
+  Cpuid(7, 0, info);
+  const unsigned int kAvx2(1u << 5), kVaes(1u << 9);
+  if ((info[1] & kAvx2) == 0 || (info[2] & kVaes) == 0)
+    return AesImplementation::kAesNi;
+  return AesImplementation::kVaes;
+}
+
+// Returns the AES-256 round key following "previous", where "assist" is the output of
+// _mm_aeskeygenassist_si128 shuffled to hold the required word in every lane
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+__m128i NextRoundKey(__m128i previous, __m128i assist) {
+  previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+  previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+  previous = _mm_xor_si128(previous, _mm_slli_si128(previous, 4));
+  return _mm_xor_si128(previous, assist);
+}
+
+// The round constant must be an immediate, hence the macro
+#define MAIDSAFE_ENCRYPT_EXPAND_KEY(i, rcon)                                                   \
+  keys[2 * i] = NextRoundKey(                                                                   \
+      keys[2 * i - 2], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(keys[2 * i - 1], rcon), 0xff)); \
+  if (2 * i + 1 <= kRounds) {                                                                   \
+    keys[2 * i + 1] = NextRoundKey(                                                             \
+        keys[2 * i - 1], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(keys[2 * i], 0), 0xaa));   \
+  }
+
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+void ExpandKey(const byte* key, byte* round_keys) {
+  __m128i keys[kRounds + 1];
+  keys[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+  keys[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 16));
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(1, 0x01)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(2, 0x02)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(3, 0x04)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(4, 0x08)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(5, 0x10)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(6, 0x20)
+  MAIDSAFE_ENCRYPT_EXPAND_KEY(7, 0x40)
+  for (int i(0); i <= kRounds; ++i)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(round_keys + 16 * i), keys[i]);
+}
+
+#undef MAIDSAFE_ENCRYPT_EXPAND_KEY
+
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+__m128i EncryptBlock(const __m128i* keys, __m128i block) {
+  block = _mm_xor_si128(block, keys[0]);
+  for (int i(1); i != kRounds; ++i)
+    block = _mm_aesenc_si128(block, keys[i]);
+  return _mm_aesenclast_si128(block, keys[kRounds]);
+}
+
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+void LoadRoundKeys(const byte* round_keys, __m128i* keys) {
+  for (int i(0); i <= kRounds; ++i)
+    keys[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(round_keys + 16 * i));
+}
+
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+void EncryptBlockAesNi(const byte* round_keys, const byte* in, byte* out) {
+  __m128i keys[kRounds + 1];
+  LoadRoundKeys(round_keys, keys);
+  __m128i block(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), EncryptBlock(keys, block));
+}
+
+// Each ciphertext block is the plaintext XORed with the encryption of the previous ciphertext
+// block, so encryption is one block at a time.  "feedback" holds the previous ciphertext block.
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+void CfbEncryptAesNi(const byte* round_keys, byte* feedback, const byte* in, byte* out,
+                     size_t blocks) {
+  __m128i keys[kRounds + 1];
+  LoadRoundKeys(round_keys, keys);
+  __m128i previous(_mm_loadu_si128(reinterpret_cast<const __m128i*>(feedback)));
+  for (size_t i(0); i != blocks; ++i) {
+    __m128i plain(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16 * i)));
+    previous = _mm_xor_si128(plain, EncryptBlock(keys, previous));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * i), previous);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(feedback), previous);
+}
+
+// Decryption has all the ciphertext up front, so four independent blocks go through the AES units
+// at once.  Each batch is loaded before any of it is stored, so "out" may equal "in".
+MAIDSAFE_ENCRYPT_AES_TARGET("aes")
+void CfbDecryptAesNi(const byte* round_keys, byte* feedback, const byte* in, byte* out,
+                     size_t blocks) {
+  __m128i keys[kRounds + 1];
+  LoadRoundKeys(round_keys, keys);
+  const __m128i* source(reinterpret_cast<const __m128i*>(in));
+  __m128i* target(reinterpret_cast<__m128i*>(out));
+  __m128i previous(_mm_loadu_si128(reinterpret_cast<const __m128i*>(feedback)));
+  size_t i(0);
+  for (; i + 4 <= blocks; i += 4) {
+    __m128i c0(_mm_loadu_si128(source + i)), c1(_mm_loadu_si128(source + i + 1));
+    __m128i c2(_mm_loadu_si128(source + i + 2)), c3(_mm_loadu_si128(source + i + 3));
+    __m128i k0(_mm_xor_si128(previous, keys[0])), k1(_mm_xor_si128(c0, keys[0]));
+    __m128i k2(_mm_xor_si128(c1, keys[0])), k3(_mm_xor_si128(c2, keys[0]));
+    for (int round(1); round != kRounds; ++round) {
+      k0 = _mm_aesenc_si128(k0, keys[round]);
+      k1 = _mm_aesenc_si128(k1, keys[round]);
+      k2 = _mm_aesenc_si128(k2, keys[round]);
+      k3 = _mm_aesenc_si128(k3, keys[round]);
+    }
+    _mm_storeu_si128(target + i, _mm_xor_si128(c0, _mm_aesenclast_si128(k0, keys[kRounds])));
+    _mm_storeu_si128(target + i + 1, _mm_xor_si128(c1, _mm_aesenclast_si128(k1, keys[kRounds])));
+    _mm_storeu_si128(target + i + 2, _mm_xor_si128(c2, _mm_aesenclast_si128(k2, keys[kRounds])));
+    _mm_storeu_si128(target + i + 3, _mm_xor_si128(c3, _mm_aesenclast_si128(k3, keys[kRounds])));
+    previous = c3;
+  }
+  for (; i != blocks; ++i) {
+    __m128i cipher(_mm_loadu_si128(source + i));
+    _mm_storeu_si128(target + i, _mm_xor_si128(cipher, EncryptBlock(keys, previous)));
+    previous = cipher;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(feedback), previous);
+}
+
+// As CfbDecryptAesNi, but with each VAES instruction handling two blocks, eight blocks at a time
+MAIDSAFE_ENCRYPT_AES_TARGET("aes,avx2,vaes")
+void CfbDecryptVaes(const byte* round_keys, byte* feedback, const byte* in, byte* out,
+                    size_t blocks) {
+  __m256i keys[kRounds + 1];
+  for (int i(0); i <= kRounds; ++i) {
+    keys[i] = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(round_keys + 16 * i)));
+  }
+  __m128i previous(_mm_loadu_si128(reinterpret_cast<const __m128i*>(feedback)));
+  size_t i(0);
+  for (; i + 8 <= blocks; i += 8) {
+    const byte* source(in + 16 * i);
+    // ciphertext blocks i to i + 7, and the blocks preceding each of them
+    __m256i c0(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source)));
+    __m256i c1(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 32)));
+    __m256i c2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 64)));
+    __m256i c3(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 96)));
+    __m256i k0(_mm256_inserti128_si256(_mm256_castsi128_si256(previous),
+                                       _mm256_castsi256_si128(c0), 1));
+    __m256i k1(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 16)));
+    __m256i k2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 48)));
+    __m256i k3(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + 80)));
+    previous = _mm256_extracti128_si256(c3, 1);
+    k0 = _mm256_xor_si256(k0, keys[0]);
+    k1 = _mm256_xor_si256(k1, keys[0]);
+    k2 = _mm256_xor_si256(k2, keys[0]);
+    k3 = _mm256_xor_si256(k3, keys[0]);
+    for (int round(1); round != kRounds; ++round) {
+      k0 = _mm256_aesenc_epi128(k0, keys[round]);
+      k1 = _mm256_aesenc_epi128(k1, keys[round]);
+      k2 = _mm256_aesenc_epi128(k2, keys[round]);
+      k3 = _mm256_aesenc_epi128(k3, keys[round]);
+    }
+    byte* target(out + 16 * i);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target),
+                        _mm256_xor_si256(c0, _mm256_aesenclast_epi128(k0, keys[kRounds])));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + 32),
+                        _mm256_xor_si256(c1, _mm256_aesenclast_epi128(k1, keys[kRounds])));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + 64),
+                        _mm256_xor_si256(c2, _mm256_aesenclast_epi128(k2, keys[kRounds])));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + 96),
+                        _mm256_xor_si256(c3, _mm256_aesenclast_epi128(k3, keys[kRounds])));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(feedback), previous);
+  CfbDecryptAesNi(round_keys, feedback, in + 16 * i, out + 16 * i, blocks - i);
+}
+
+#else
+
+AesImplementation DetectImplementation() { return AesImplementation::kPortable; }
+
+#endif
+
+}  // unnamed namespace
+
+AesImplementation BestAesImplementation() {
+  static const AesImplementation kBest(DetectImplementation());
+  return kBest;
+}
+
+const char* AesImplementationName(AesImplementation implementation) {
+  switch (implementation) {
+    case AesImplementation::kAesNi:
+      return "AES-NI";
+    case AesImplementation::kVaes:
+      return "VAES";
+    default:
+      return "portable";
+  }
+}
+
+AesCfb::AesCfb(const byte* key, const byte* iv, bool encrypt, AesImplementation implementation)
+    : kEncrypt_(encrypt),
+      kImplementation_(implementation),
+      portable_(),
+      round_keys_(),
+      feedback_(),
+      keystream_(),
+      keystream_used_(kBlockSize) {
+  assert(implementation <= BestAesImplementation());
+#ifdef MAIDSAFE_ENCRYPT_AES_NI
+  if (kImplementation_ != AesImplementation::kPortable) {
+    ExpandKey(key, round_keys_.data());
+    std::memcpy(feedback_.data(), iv, kBlockSize);
+    return;
+  }
+#endif
+  if (kEncrypt_) {
+    portable_.reset(
+        new CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption(key, crypto::AES256_KeySize, iv));
+  } else {
+    portable_.reset(
+        new CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption(key, crypto::AES256_KeySize, iv));
+  }
+}
+
+AesCfb::~AesCfb() {}
+
+void AesCfb::Rekey(const byte* key, const byte* iv) {
+  keystream_used_ = kBlockSize;
+  if (portable_) {
+    portable_->SetKeyWithIV(key, crypto::AES256_KeySize, iv);
+    return;
+  }
+#ifdef MAIDSAFE_ENCRYPT_AES_NI
+  ExpandKey(key, round_keys_.data());
+  std::memcpy(feedback_.data(), iv, kBlockSize);
+#endif
+}
+
+void AesCfb::ProcessData(byte* out, const byte* in, size_t length) {
+  if (portable_) {
+    portable_->ProcessData(out, in, length);
+    return;
+  }
+#ifdef MAIDSAFE_ENCRYPT_AES_NI
+  while (length != 0) {
+    if (keystream_used_ == kBlockSize) {
+      // Whole blocks go straight through the block kernels
+      size_t blocks(length / kBlockSize);
+      if (blocks != 0) {
+        if (kEncrypt_)
+          CfbEncryptAesNi(round_keys_.data(), feedback_.data(), in, out, blocks);
+        else if (kImplementation_ == AesImplementation::kVaes)
+          CfbDecryptVaes(round_keys_.data(), feedback_.data(), in, out, blocks);
+        else
+          CfbDecryptAesNi(round_keys_.data(), feedback_.data(), in, out, blocks);
+        in += blocks * kBlockSize;
+        out += blocks * kBlockSize;
+        length -= blocks * kBlockSize;
+        continue;
+      }
+      EncryptBlockAesNi(round_keys_.data(), feedback_.data(), keystream_.data());
+      keystream_used_ = 0;
+    }
+    // Otherwise use up the current keystream block a byte at a time
+    byte cipher(kEncrypt_ ? *in ^ keystream_[keystream_used_] : *in);
+    *out = *in ^ keystream_[keystream_used_];
+    feedback_[keystream_used_++] = cipher;
+    ++in;
+    ++out;
+    --length;
+  }
+#endif
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,82 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_AES_CFB_H_
+#define MAIDSAFE_ENCRYPT_AES_CFB_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/types.h"
+
+namespace CryptoPP {
+
+class SymmetricCipher;
+
+}  // namespace CryptoPP
+
+namespace maidsafe {
+
+namespace encrypt {
+
+enum class AesImplementation {
+  kPortable,  // CryptoPP
+  kAesNi,
+  kVaes  // AES-NI, with decryption eight blocks at a time using 256-bit VAES
+};
+
+// The fastest implementation the CPU supports, determined once
+AesImplementation BestAesImplementation();
+const char* AesImplementationName(AesImplementation implementation);
+
+// AES-256 in CFB mode with 128-bit feedback, producing exactly the same output as
+// CryptoPP::CFB_Mode<CryptoPP::AES>.  Data may be processed in pieces of any size.  CFB
+// encryption is inherently serial, but decryption with AES-NI or VAES runs several blocks at once.
+class AesCfb {
+ public:
+  AesCfb(const byte* key, const byte* iv, bool encrypt,
+         AesImplementation implementation = BestAesImplementation());
+  ~AesCfb();
+  AesCfb(const AesCfb&) = delete;
+  AesCfb(AesCfb&&) = delete;
+  AesCfb& operator=(AesCfb) = delete;
+
+  // Restarts with a new key and IV, reusing this object's state rather than allocating afresh
+  void Rekey(const byte* key, const byte* iv);
+  // "out" may be the same as "in"
+  void ProcessData(byte* out, const byte* in, size_t length);
+
+ private:
+  static const size_t kBlockSize = 16;
+
+  const bool kEncrypt_;
+  const AesImplementation kImplementation_;
+  std::unique_ptr<CryptoPP::SymmetricCipher> portable_;
+  std::array<byte, 15 * kBlockSize> round_keys_;
+  // the last ciphertext block (initially the IV), its encryption, and how much of that is used
+  std::array<byte, kBlockSize> feedback_, keystream_;
+  size_t keystream_used_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_AES_CFB_H_
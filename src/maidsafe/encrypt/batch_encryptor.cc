@@ -0,0 +1,131 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/batch_encryptor.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "boost/filesystem/fstream.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/identity.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/encrypt/buffer_pool.h"
+#include "maidsafe/encrypt/self_encryptor.h"
+#include "maidsafe/encrypt/thread_pool.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+void EncryptFile(const FileReader& reader, size_t index, DataMap& data_map, DataBuffer& buffer,
+                 const std::function<NonEmptyString(const std::string&)>& get_from_store,
+                 const Executor& executor) {
+  SelfEncryptor self_encryptor(data_map, buffer, get_from_store,
+                               MemoryUsage(kDefaultMaxMemoryUsage), boost::filesystem::path(),
+                               executor);
+  self_encryptor.SetBackgroundEncryption(true);
+  Buffer piece(DefaultBufferPool().Get(kMaxChunkSize));
+  char* data(reinterpret_cast<char*>(piece.data()));
+  uint64_t position(0);
+  uint32_t length(0);
+  try {
+    do {
+      length = reader(data, kMaxChunkSize);
+      if (length > kMaxChunkSize) {
+        LOG(kError) << "Reader of file " << index << " of batch returned " << length << " bytes.";
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+      }
+      if (length != 0 && !self_encryptor.Write(data, length, position)) {
+        LOG(kError) << "Failed to write file " << index << " of batch.";
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unknown));
+      }
+      position += length;
+    } while (length == kMaxChunkSize);
+  } catch (const std::exception&) {
+    // the batch is abandoned, so the part of the file already written needn't be encrypted
+    self_encryptor.Truncate(0);
+    self_encryptor.Close();
+    throw;
+  }
+  DefaultBufferPool().Return(std::move(piece));
+  self_encryptor.Close();
+}
+
+}  // unnamed namespace
+
+std::vector<DataMap> EncryptFiles(const std::vector<FileReader>& readers, DataBuffer& buffer,
+                                  const Executor& executor) {
+  const Executor shared_executor(executor ? executor : DefaultExecutor());
+  std::vector<DataMap> data_maps(readers.size());
+  // new files never read chunks back, but a SelfEncryptor needs a source for them
+  std::function<NonEmptyString(const std::string&)> get_from_store(
+      [&buffer](const std::string& name) {
+        return buffer.Get(DataBuffer::KeyType(Identity(name), DataTypeId(0)));
+      });
+
+  TaskGroup files(shared_executor, static_cast<unsigned>(Concurrency()));
+  for (size_t i(0); i != readers.size(); ++i) {
+    files.Run([&, i] {
+      EncryptFile(readers[i], i, data_maps[i], buffer, get_from_store, shared_executor);
+    });
+  }
+  files.Wait();
+  return data_maps;
+}
+
+std::vector<DataMap> EncryptFiles(const std::vector<boost::filesystem::path>& paths,
+                                  DataBuffer& buffer, const Executor& executor) {
+  // each file is only opened once its task starts, so the batch doesn't hold every file open
+  std::vector<FileReader> readers;
+  for (const auto& path : paths) {
+    auto stream(std::make_shared<boost::filesystem::ifstream>());
+    readers.push_back([path, stream](char* data, uint32_t length) -> uint32_t {
+      if (!stream->is_open()) {
+        stream->open(path, std::ios::binary);
+        if (!stream->is_open()) {
+          LOG(kError) << "Failed to open " << path;
+          BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+        }
+      }
+      stream->read(data, length);
+      if (stream->bad()) {
+        LOG(kError) << "Failed to read " << path;
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+      }
+      auto count(static_cast<uint32_t>(stream->gcount()));
+      if (count != length)
+        stream->close();
+      return count;
+    });
+  }
+  return EncryptFiles(readers, buffer, executor);
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,297 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/blake2bp.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAIDSAFE_ENCRYPT_BLAKE2BP_AVX2 1
+#endif
+
+#ifdef __GNUC__
+#define MAIDSAFE_ENCRYPT_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define MAIDSAFE_ENCRYPT_ALWAYS_INLINE inline
+#endif
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+const uint64_t kIv[8] = {0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+                         0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+                         0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+const uint8_t kSigma[12][16] = {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+                                {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+                                {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+                                {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+                                {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+                                {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+                                {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+                                {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+                                {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+                                {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+                                {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+                                {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}};
+
+const size_t kLeafCount(4), kBlockBytes(128), kDigestBytes(64);
+const uint64_t kFinal(~0ULL);
+
+uint64_t LoadLittleEndian(const byte* in) {
+  uint64_t word(0);
+  for (int i(7); i >= 0; --i)
+    word = (word << 8) | in[i];
+  return word;
+}
+
+void StoreLittleEndian(uint64_t word, byte* out) {
+  for (int i(0); i != 8; ++i)
+    out[i] = static_cast<byte>(word >> (8 * i));
+}
+
+// Parameter block words 0 to 2 for a node of the tree: 64-byte digest, fanout 4, depth 2 and inner
+// length 64; all other parameters are zero
+void InitialiseNode(uint64_t node_offset, uint64_t node_depth, uint64_t* h) {
+  h[0] = kIv[0] ^ (kDigestBytes | (kLeafCount << 16) | (2ULL << 24));
+  h[1] = kIv[1] ^ node_offset;
+  h[2] = kIv[2] ^ (node_depth | (kDigestBytes << 8));
+  for (int i(3); i != 8; ++i)
+    h[i] = kIv[i];
+}
+
+// A macro rather than a function, as returning a vector from a function without the target's
+// instruction set enabled changes the ABI
+#define MAIDSAFE_ENCRYPT_ROTR(x, bits) (((x) >> (bits)) | ((x) << (64 - (bits))))
+
+#define MAIDSAFE_ENCRYPT_G(a, b, c, d, x, y) \
+  a = a + b + (x);                           \
+  d = MAIDSAFE_ENCRYPT_ROTR(d ^ a, 32);      \
+  c = c + d;                                 \
+  b = MAIDSAFE_ENCRYPT_ROTR(b ^ c, 24);      \
+  a = a + b + (y);                           \
+  d = MAIDSAFE_ENCRYPT_ROTR(d ^ a, 16);      \
+  c = c + d;                                 \
+  b = MAIDSAFE_ENCRYPT_ROTR(b ^ c, 63);
+
+// The BLAKE2b compression function, where "Word" is either a single uint64_t or a vector of them
+// for several nodes compressed at once with the same counter and flags
+template <typename Word>
+MAIDSAFE_ENCRYPT_ALWAYS_INLINE void Compress(Word (&h)[8], const Word (&m)[16], uint64_t counter, uint64_t final_block,
+                     uint64_t last_node) {
+  const Word kZero = Word();
+  Word v[16];
+  for (int i(0); i != 8; ++i) {
+    v[i] = h[i];
+    v[i + 8] = kZero + kIv[i];
+  }
+  v[12] = v[12] ^ counter;
+  v[14] = v[14] ^ final_block;
+  v[15] = v[15] ^ last_node;
+  for (int round(0); round != 12; ++round) {
+    const uint8_t* s(kSigma[round]);
+    MAIDSAFE_ENCRYPT_G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]])
+    MAIDSAFE_ENCRYPT_G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]])
+    MAIDSAFE_ENCRYPT_G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]])
+    MAIDSAFE_ENCRYPT_G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]])
+    MAIDSAFE_ENCRYPT_G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]])
+    MAIDSAFE_ENCRYPT_G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]])
+    MAIDSAFE_ENCRYPT_G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]])
+    MAIDSAFE_ENCRYPT_G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]])
+  }
+  for (int i(0); i != 8; ++i)
+    h[i] = h[i] ^ v[i] ^ v[i + 8];
+}
+
+void CompressBlock(uint64_t (&h)[8], const byte* block, uint64_t counter, uint64_t final_block,
+                   uint64_t last_node) {
+  uint64_t m[16];
+  for (int i(0); i != 16; ++i)
+    m[i] = LoadLittleEndian(block + 8 * i);
+  Compress(h, m, counter, final_block, last_node);
+}
+
+// Compresses a non-final block into each leaf, one leaf at a time
+void CompressStripesPortable(uint64_t (&state)[8][kLeafCount], const byte* data, size_t count,
+                             uint64_t counter) {
+  for (size_t stripe(0); stripe != count; ++stripe, counter += kBlockBytes) {
+    for (size_t leaf(0); leaf != kLeafCount; ++leaf) {
+      uint64_t h[8];
+      for (int i(0); i != 8; ++i)
+        h[i] = state[i][leaf];
+      CompressBlock(h, data + (stripe * kLeafCount + leaf) * kBlockBytes, counter, 0, 0);
+      for (int i(0); i != 8; ++i)
+        state[i][leaf] = h[i];
+    }
+  }
+}
+
+#ifdef MAIDSAFE_ENCRYPT_BLAKE2BP_AVX2
+
+typedef uint64_t Vector4 __attribute__((vector_size(32)));
+
+// As CompressStripesPortable, but with each leaf in a lane of the vectors.  x86 is little-endian,
+// so the message words are loaded directly.
+MAIDSAFE_ENCRYPT_ALWAYS_INLINE void CompressStripesVector(uint64_t (&state)[8][kLeafCount],
+                                                          const byte* data, size_t count,
+                                                          uint64_t counter) {
+  Vector4 h[8];
+  for (int i(0); i != 8; ++i)
+    std::memcpy(&h[i], state[i], sizeof(Vector4));
+  for (size_t stripe(0); stripe != count; ++stripe, counter += kBlockBytes) {
+    const byte* blocks(data + stripe * kLeafCount * kBlockBytes);
+    Vector4 m[16];
+    for (int i(0); i != 16; ++i) {
+      for (size_t leaf(0); leaf != kLeafCount; ++leaf) {
+        uint64_t word;
+        std::memcpy(&word, blocks + leaf * kBlockBytes + 8 * i, sizeof(word));
+        m[i][leaf] = word;
+      }
+    }
+    Compress(h, m, counter, 0, 0);
+  }
+  for (int i(0); i != 8; ++i)
+    std::memcpy(state[i], &h[i], sizeof(Vector4));
+}
+
+__attribute__((target("avx2")))
+void CompressStripesAvx2(uint64_t (&state)[8][kLeafCount], const byte* data, size_t count,
+                         uint64_t counter) {
+  CompressStripesVector(state, data, count, counter);
+}
+
+// AVX-512VL adds 64-bit rotates and twice the registers, on the same 256-bit vectors
+__attribute__((target("avx512f,avx512vl")))
+void CompressStripesAvx512(uint64_t (&state)[8][kLeafCount], const byte* data, size_t count,
+                           uint64_t counter) {
+  CompressStripesVector(state, data, count, counter);
+}
+
+#endif
+
+#undef MAIDSAFE_ENCRYPT_G
+#undef MAIDSAFE_ENCRYPT_ROTR
+#undef MAIDSAFE_ENCRYPT_ALWAYS_INLINE
+
+typedef void (*StripeKernel)(uint64_t (&state)[8][kLeafCount], const byte* data, size_t count,
+                             uint64_t counter);
+
+StripeKernel SelectKernel() {
+#ifdef MAIDSAFE_ENCRYPT_BLAKE2BP_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vl"))
+    return CompressStripesAvx512;
+  if (__builtin_cpu_supports("avx2"))
+    return CompressStripesAvx2;
+#endif
+  return CompressStripesPortable;
+}
+
+}  // unnamed namespace
+
+const size_t Blake2bp::kLeaves, Blake2bp::kBlockSize, Blake2bp::kStripeSize, Blake2bp::kHeldBack;
+
+Blake2bp::Blake2bp() : state_(), compressed_(0), buffer_(), buffered_(0) { Restart(); }
+
+void Blake2bp::Restart() {
+  for (size_t leaf(0); leaf != kLeaves; ++leaf) {
+    uint64_t h[8];
+    InitialiseNode(leaf, 0, h);
+    for (int i(0); i != 8; ++i)
+      state_[i][leaf] = h[i];
+  }
+  compressed_ = 0;
+  buffered_ = 0;
+}
+
+void Blake2bp::CompressStripes(const byte* data, size_t count) {
+  static const StripeKernel kernel(SelectKernel());
+  kernel(state_, data, count, compressed_ + kBlockSize);
+  compressed_ += count * kBlockSize;
+}
+
+void Blake2bp::Update(const byte* data, size_t length) {
+  while (buffered_ + length > kHeldBack) {
+    if (buffered_ == 0) {
+      // straight from the input, leaving at most kHeldBack bytes
+      size_t count((length - kHeldBack + kStripeSize - 1) / kStripeSize);
+      CompressStripes(data, count);
+      data += count * kStripeSize;
+      length -= count * kStripeSize;
+      break;
+    }
+    if (buffered_ < kStripeSize) {
+      size_t fill(kStripeSize - buffered_);
+      std::memcpy(buffer_.data() + buffered_, data, fill);
+      data += fill;
+      length -= fill;
+      buffered_ = kStripeSize;
+    }
+    CompressStripes(buffer_.data(), 1);
+    buffered_ -= kStripeSize;
+    std::memmove(buffer_.data(), buffer_.data() + kStripeSize, buffered_);
+  }
+  if (length != 0) {
+    std::memcpy(buffer_.data() + buffered_, data, length);
+    buffered_ += length;
+  }
+}
+
+void Blake2bp::Final(byte* digest) {
+  // the buffer starts at a stripe boundary and holds every leaf's final block
+  std::array<byte, kLeaves * DIGESTSIZE> leaf_digests;
+  for (size_t leaf(0); leaf != kLeaves; ++leaf) {
+    uint64_t h[8];
+    for (int i(0); i != 8; ++i)
+      h[i] = state_[i][leaf];
+    uint64_t counter(compressed_);
+    uint64_t last_node(leaf == kLeaves - 1 ? kFinal : 0);
+    size_t offset(leaf * kBlockSize);
+    assert(offset < buffered_ || compressed_ == 0);
+    for (; offset + kStripeSize < buffered_; offset += kStripeSize) {
+      counter += kBlockSize;
+      CompressBlock(h, buffer_.data() + offset, counter, 0, 0);
+    }
+    std::array<byte, kBlockSize> block = {};
+    if (offset < buffered_) {
+      size_t size(std::min(kBlockSize, buffered_ - offset));
+      std::memcpy(block.data(), buffer_.data() + offset, size);
+      counter += size;
+    }
+    CompressBlock(h, block.data(), counter, kFinal, last_node);
+    for (int i(0); i != 8; ++i)
+      StoreLittleEndian(h[i], leaf_digests.data() + leaf * DIGESTSIZE + 8 * i);
+  }
+
+  uint64_t root[8];
+  InitialiseNode(0, 1, root);
+  CompressBlock(root, leaf_digests.data(), kBlockSize, 0, 0);
+  CompressBlock(root, leaf_digests.data() + kBlockSize, 2 * kBlockSize, kFinal, kFinal);
+  for (int i(0); i != 8; ++i)
+    StoreLittleEndian(root[i], digest + 8 * i);
+  Restart();
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
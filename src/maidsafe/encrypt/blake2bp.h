@@ -0,0 +1,69 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_BLAKE2BP_H_
+#define MAIDSAFE_ENCRYPT_BLAKE2BP_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "maidsafe/encrypt/config.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// BLAKE2bp with a 64-byte digest, as specified alongside BLAKE2b in RFC 7693's reference
+// implementation: the input is dealt out a 128-byte block at a time to four BLAKE2b leaves, and a
+// root BLAKE2b hashes their digests.  The four leaves run in the lanes of AVX2 registers where the
+// CPU supports it, and one after another otherwise.
+class Blake2bp {
+ public:
+  enum { DIGESTSIZE = 64 };
+
+  Blake2bp();
+
+  void Update(const byte* data, size_t length);
+  // Writes the digest of everything passed to Update and restarts
+  void Final(byte* digest);
+  void Restart();
+  void CalculateDigest(byte* digest, const byte* data, size_t length) {
+    Update(data, length);
+    Final(digest);
+  }
+
+ private:
+  static const size_t kLeaves = 4, kBlockSize = 128, kStripeSize = kLeaves * kBlockSize;
+  // A leaf's final block must be compressed differently, so a stripe is only compressed once more
+  // than a stripe plus three blocks follow its start; every leaf then has input after it.
+  static const size_t kHeldBack = kStripeSize + (kLeaves - 1) * kBlockSize;
+
+  void CompressStripes(const byte* data, size_t count);
+
+  uint64_t state_[8][kLeaves];  // state_[i][leaf] is word i of the leaf's chaining value
+  uint64_t compressed_;         // bytes compressed by each leaf so far
+  std::array<byte, kHeldBack> buffer_;
+  size_t buffered_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_BLAKE2BP_H_
@@ -0,0 +1,127 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/buffer_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <utility>
+
+#include "boost/align/aligned_alloc.hpp"
+
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+std::atomic<uint64_t> g_buffer_allocations(0);
+
+}  // unnamed namespace
+
+const size_t Buffer::kAlignment;
+const size_t BufferPool::kMinClassShift;
+const size_t BufferPool::kClassCount;
+const size_t BufferPool::kSmallClassBytes;
+
+Buffer::Buffer(size_t capacity)
+    : data_(static_cast<byte*>(boost::alignment::aligned_alloc(kAlignment, capacity))),
+      size_(0),
+      capacity_(capacity) {
+  if (!data_ && capacity != 0)
+    throw std::bad_alloc();
+  ++g_buffer_allocations;
+}
+
+Buffer::~Buffer() { boost::alignment::aligned_free(data_); }
+
+Buffer::Buffer(Buffer&& other) noexcept : data_(other.data_), size_(other.size_),
+                                          capacity_(other.capacity_) {
+  other.data_ = nullptr;
+  other.size_ = other.capacity_ = 0;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+  std::swap(capacity_, other.capacity_);
+  return *this;
+}
+
+void Buffer::resize(size_t size) {
+  assert(size <= capacity_);
+  size_ = size;
+}
+
+uint64_t BufferAllocations() { return g_buffer_allocations; }
+
+BufferPool::BufferPool(size_t max_buffers) : kMaxBuffers_(max_buffers), classes_() {
+  static_assert(size_t(1) << (kMinClassShift + kClassCount - 1) == kMaxChunkSize,
+                "largest size class must hold a chunk");
+}
+
+Buffer BufferPool::Get(size_t size) {
+  size_t index(0);
+  while (index != kClassCount && (size_t(1) << (kMinClassShift + index)) < size)
+    ++index;
+  if (index == kClassCount) {
+    // larger than any chunk, so not worth keeping
+    Buffer buffer(size);
+    buffer.resize(size);
+    return buffer;
+  }
+  Buffer buffer;
+  {
+    SizeClass& size_class(classes_[index]);
+    std::lock_guard<std::mutex> guard(size_class.mutex);
+    if (!size_class.buffers.empty()) {
+      buffer = std::move(size_class.buffers.back());
+      size_class.buffers.pop_back();
+    }
+  }
+  if (buffer.capacity() == 0)
+    buffer = Buffer(size_t(1) << (kMinClassShift + index));
+  buffer.resize(size);
+  return buffer;
+}
+
+void BufferPool::Return(Buffer buffer) {
+  for (size_t index(0); index != kClassCount; ++index) {
+    if (buffer.capacity() != (size_t(1) << (kMinClassShift + index)))
+      continue;
+    SizeClass& size_class(classes_[index]);
+    std::lock_guard<std::mutex> guard(size_class.mutex);
+    if (size_class.buffers.size() <
+        std::max(kMaxBuffers_, kSmallClassBytes >> (kMinClassShift + index)))
+      size_class.buffers.push_back(std::move(buffer));
+    return;
+  }
+}
+
+BufferPool& DefaultBufferPool() {
+  static BufferPool pool(2 * static_cast<size_t>(std::max(Concurrency(), 1)));
+  return pool;
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,102 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_BUFFER_POOL_H_
+#define MAIDSAFE_ENCRYPT_BUFFER_POOL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "maidsafe/encrypt/config.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// A heap buffer of bytes aligned for SIMD loads.  Its contents are left uninitialised, and resizing
+// within its capacity neither reallocates nor touches the memory.
+class Buffer {
+ public:
+  static const size_t kAlignment = 64;
+
+  Buffer() : data_(nullptr), size_(0), capacity_(0) {}
+  explicit Buffer(size_t capacity);
+  ~Buffer();
+  Buffer(Buffer&& other) noexcept;
+  Buffer& operator=(Buffer&& other) noexcept;
+  Buffer(const Buffer&) = delete;
+  Buffer& operator=(const Buffer&) = delete;
+
+  byte* data() { return data_; }
+  const byte* data() const { return data_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  // "size" must not exceed capacity()
+  void resize(size_t size);
+
+ private:
+  byte* data_;
+  size_t size_, capacity_;
+};
+
+// How many Buffers have been allocated so far by the whole process, so that tests can check that
+// steady-state work allocates none
+uint64_t BufferAllocations();
+
+// Recycles the buffers used while hashing, encrypting and decrypting, so that after the first few
+// chunks these no longer need to be allocated.  Buffers are pooled by size class, each a power of
+// two from 64 bytes up to kMaxChunkSize, so that the small buffers used for pre-hashes and the
+// chunk-sized ones are never mistaken for each other.  At most "max_buffers" of each class are kept
+// for reuse, other than of the small classes, which may keep up to 1 MiB's worth since a task may
+// hold a batch of these at once.
+class BufferPool {
+ public:
+  explicit BufferPool(size_t max_buffers);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool(BufferPool&&) = delete;
+  BufferPool& operator=(BufferPool) = delete;
+
+  // The returned buffer has "size" bytes with unspecified contents
+  Buffer Get(size_t size);
+  void Return(Buffer buffer);
+
+ private:
+  static const size_t kMinClassShift = 6, kClassCount = 15;  // 64 bytes to 1 MiB
+  static const size_t kSmallClassBytes = 1024 * 1024;
+  struct SizeClass {
+    SizeClass() : buffers(), mutex() {}
+    std::vector<Buffer> buffers;
+    std::mutex mutex;
+  };
+
+  const size_t kMaxBuffers_;
+  std::array<SizeClass, kClassCount> classes_;
+};
+
+// A pool shared by all SelfEncryptors, keeping enough of each size class for every thread of
+// DefaultExecutor to hold two
+BufferPool& DefaultBufferPool();
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_BUFFER_POOL_H_
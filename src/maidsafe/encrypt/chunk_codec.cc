@@ -0,0 +1,247 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/chunk_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <exception>
+#include <memory>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/algparam.h"
+#include "cryptopp/argnames.h"
+#include "cryptopp/filters.h"
+#include "cryptopp/gzip.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/encrypt/aes_cfb.h"
+#include "maidsafe/encrypt/gzip.h"
+#include "maidsafe/encrypt/lz4.h"
+#include "maidsafe/encrypt/xor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+// WorthCompressing checks up to this many samples of this size from each chunk, and looks for them
+// to shrink by at least kMinSaving
+const uint32_t kSampleCount(4), kSampleSize(8 * 1024);
+const double kMinSaving(0.03);
+
+// Appends everything put to it to the output it was last reset to, encrypting and XORing the new
+// bytes in place
+class EncryptingSink : public CryptoPP::Bufferless<CryptoPP::Sink> {
+ public:
+  EncryptingSink() : output_(nullptr), encryptor_(nullptr), pad_(nullptr) {}
+  EncryptingSink(const EncryptingSink&) = delete;
+  EncryptingSink& operator=(const EncryptingSink&) = delete;
+
+  void Reset(std::string& output, AesCfb& encryptor, const byte* pad) {
+    output_ = &output;
+    encryptor_ = &encryptor;
+    pad_ = pad;
+  }
+
+  size_t Put2(const byte* in_string, size_t length, int, bool) override {
+    if (length == 0)
+      return 0;
+    size_t offset(output_->size());
+    output_->append(reinterpret_cast<const char*>(in_string), length);
+    byte* out(reinterpret_cast<byte*>(&(*output_)[offset]));
+    encryptor_->ProcessData(out, out, length);
+    XorWithPad(out, out, length, pad_, kPadSize, offset % kPadSize);
+    return 0;
+  }
+
+ private:
+  std::string* output_;
+  AesCfb* encryptor_;
+  const byte* pad_;
+};
+
+// What each thread reuses from one chunk to the next rather than setting up afresh: the ciphers
+// are rekeyed, the Gzip compressor, whose window and hash chains are its costliest part, is
+// reinitialised in place for each chunk, and a scratch buffer grows to the largest chunk seen
+struct CodecContext {
+  CodecContext() : encryptor(), decryptor(), gzip_sink(nullptr), gzip(), scratch() {}
+
+  std::unique_ptr<AesCfb> encryptor, decryptor;
+  EncryptingSink* gzip_sink;  // owned by gzip
+  std::unique_ptr<CryptoPP::Gzip> gzip;
+  ByteVector scratch;
+};
+
+CodecContext& Context() {
+  thread_local CodecContext context;
+  return context;
+}
+
+AesCfb& Rekeyed(std::unique_ptr<AesCfb>& cipher, const byte* key, const byte* iv, bool encrypt) {
+  if (cipher)
+    cipher->Rekey(key, iv);
+  else
+    cipher.reset(new AesCfb(key, iv, encrypt));
+  return *cipher;
+}
+
+// Returns the context's scratch buffer with room for at least "size" bytes
+byte* Scratch(CodecContext& context, size_t size) {
+  if (context.scratch.size() < size)
+    context.scratch.resize(size);
+  return context.scratch.data();
+}
+
+}  // unnamed namespace
+
+bool SupportsCompression(EncryptionAlgorithm version, ChunkCompression compression) {
+  switch (compression) {
+    case ChunkCompression::kGzip:
+      return true;
+    case ChunkCompression::kLz4:
+      return version != EncryptionAlgorithm::kSelfEncryptionVersion0 &&
+             version != EncryptionAlgorithm::kSelfEncryptionVersion1;
+    default:
+      return false;
+  }
+}
+
+bool SupportsUncompressed(EncryptionAlgorithm version) {
+  return version != EncryptionAlgorithm::kSelfEncryptionVersion0 &&
+         version != EncryptionAlgorithm::kSelfEncryptionVersion1;
+}
+
+bool WorthCompressing(const byte* data, uint32_t length) {
+  std::array<byte, kSampleCount * kSampleSize> gathered;
+  const byte* samples(data);
+  uint32_t sampled(length);
+  if (length > gathered.size()) {
+    for (uint32_t i(0); i != kSampleCount; ++i) {
+      const byte* sample(data + static_cast<uint64_t>(length - kSampleSize) * i /
+                                    (kSampleCount - 1));
+      std::copy(sample, sample + kSampleSize, std::begin(gathered) + i * kSampleSize);
+    }
+    samples = gathered.data();
+    sampled = static_cast<uint32_t>(gathered.size());
+  }
+  const double kTarget((1.0 - kMinSaving) * sampled);
+
+  // the size an ideal order-0 entropy coder would achieve, which is roughly the best deflate's
+  // Huffman coding can do without repeats
+  std::array<uint32_t, 256> counts;
+  counts.fill(0);
+  for (uint32_t i(0); i != sampled; ++i)
+    ++counts[samples[i]];
+  double bits(0.0);
+  for (uint32_t count : counts) {
+    if (count != 0)
+      bits -= count * std::log2(static_cast<double>(count) / sampled);
+  }
+  if (bits / 8 < kTarget)
+    return true;
+
+  // evenly spread byte values can still compress well if sequences repeat
+  byte* compressed(Scratch(Context(), Lz4CompressBound(sampled)));
+  return Lz4Compress(samples, sampled, compressed) < kTarget;
+}
+
+EncodedChunk EncodeChunk(const byte* data, uint32_t length, EncryptionAlgorithm version,
+                         ChunkCompression compression, int level, const byte* key, const byte* iv,
+                         const byte* pad) {
+  CodecContext& context(Context());
+  AesCfb& encryptor(Rekeyed(context.encryptor, key, iv, true));
+  EncodedChunk encoded = {std::string(),
+                          !SupportsUncompressed(version) || WorthCompressing(data, length)};
+  std::string& output(encoded.content);
+  if (!encoded.compressed || compression == ChunkCompression::kLz4) {
+    byte* out(nullptr);
+    if (encoded.compressed) {
+      output.resize(Lz4CompressBound(length));
+      out = reinterpret_cast<byte*>(&output[0]);
+      output.resize(Lz4Compress(data, length, out));
+    } else {
+      output.assign(reinterpret_cast<const char*>(data), length);
+      out = reinterpret_cast<byte*>(&output[0]);
+    }
+    encryptor.ProcessData(out, out, output.size());
+    XorWithPad(out, out, output.size(), pad, kPadSize, 0);
+    return encoded;
+  }
+  // room for incompressible data stored in deflate's 64KiB blocks, plus the gzip header and footer
+  output.reserve(length + 5 * (length / 65535 + 1) + 32);
+  if (!context.gzip) {
+    context.gzip_sink = new EncryptingSink;
+    context.gzip.reset(new CryptoPP::Gzip(context.gzip_sink, level));
+  } else {
+    // the deflater drops its own level to 0 on meeting incompressible input and a new message
+    // doesn't restore it, so only a full reinitialisation keeps each chunk's encoding independent
+    // of the chunks the thread encoded before; the buffers are kept as they're already sized
+    context.gzip->IsolatedInitialize(
+        CryptoPP::MakeParameters(CryptoPP::Name::DeflateLevel(), level));
+  }
+  context.gzip_sink->Reset(output, encryptor, pad);
+  try {
+    context.gzip->Put2(data, length, -1, true);
+  } catch (const std::exception&) {
+    // a compressor left part way through a message can't be reused
+    context.gzip.reset();
+    throw;
+  }
+  return encoded;
+}
+
+void DecodeChunk(const byte* content, size_t content_size, ChunkCompression compression,
+                 bool compressed, const byte* key, const byte* iv, const byte* pad, byte* out,
+                 uint32_t length) {
+  CodecContext& context(Context());
+  AesCfb& decryptor(Rekeyed(context.decryptor, key, iv, false));
+  if (!compressed) {
+    if (content_size != length) {
+      LOG(kError) << "Uncompressed chunk content has " << content_size << " bytes, not " << length;
+      BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::failed_to_decrypt));
+    }
+    XorWithPad(content, out, content_size, pad, kPadSize, 0);
+    decryptor.ProcessData(out, out, content_size);
+    return;
+  }
+  byte* decrypted(Scratch(context, content_size));
+  XorWithPad(content, decrypted, content_size, pad, kPadSize, 0);
+  decryptor.ProcessData(decrypted, decrypted, content_size);
+  bool decompressed(compression == ChunkCompression::kLz4 ?
+                        Lz4Decompress(decrypted, content_size, out, length) :
+                        GzipDecompress(decrypted, content_size, out, length));
+  if (!decompressed) {
+    LOG(kError) << "Chunk content doesn't decompress to " << length << " bytes";
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::failed_to_decrypt));
+  }
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
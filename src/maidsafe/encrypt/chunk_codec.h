@@ -0,0 +1,89 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_CHUNK_CODEC_H_
+#define MAIDSAFE_ENCRYPT_CHUNK_CODEC_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/types.h"
+
+#include "maidsafe/encrypt/data_map.h"
+#include "maidsafe/encrypt/xor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Encodes and decodes chunk contents as self-encryption does: compression, then AES-256 in CFB
+// mode, then XOR with the kPadSize-byte "pad".  With kGzip, compression is Gzip at the given
+// deflate level; version 0 always used level 1, but any level decodes the same way.  Rather than
+// passing the data through a chain of CryptoPP filters, each with its own buffer, the compressor's
+// output is encrypted and XORed in place in the single output buffer as it's produced, and when
+// decoding, the input is decrypted into one buffer which is decompressed in a single call (see
+// gzip.h for the implementations used).
+// With kLz4, the chunk is compressed as a single LZ4 block.  From version 2, chunks which wouldn't
+// shrink appreciably skip the compression step; earlier versions always compress, so that their
+// chunks are unchanged.
+
+// True if self-encryption version "version" allows chunks to be compressed with "compression"
+bool SupportsCompression(EncryptionAlgorithm version, ChunkCompression compression);
+
+// True if self-encryption version "version" records which chunks are stored uncompressed, so
+// allows chunks which look incompressible to skip compression
+bool SupportsUncompressed(EncryptionAlgorithm version);
+
+// True unless the "length" bytes at "data" look incompressible.  A few evenly spaced samples are
+// checked for both an uneven spread of byte values and repeated sequences, so that already
+// compressed media and archives are recognised at a small fraction of the cost of compressing them.
+bool WorthCompressing(const byte* data, uint32_t length);
+
+// The key and IV for AES-256 and the pad XORed over a chunk, which self-encryption derives from
+// the pre-hashes of the chunk and the two before it
+struct ChunkKeys {
+  std::array<byte, crypto::AES256_KeySize> key;
+  std::array<byte, crypto::AES256_IVSize> iv;
+  std::array<byte, kPadSize> pad;
+};
+
+struct EncodedChunk {
+  std::string content;
+  bool compressed;
+};
+
+// Returns the encoded form of the "length" bytes at "data", as self-encryption version "version"
+// stores it: compressed unless SupportsUncompressed(version) and not WorthCompressing.
+// "level" is ignored unless "compression" is kGzip.
+EncodedChunk EncodeChunk(const byte* data, uint32_t length, EncryptionAlgorithm version,
+                         ChunkCompression compression, int level, const byte* key, const byte* iv,
+                         const byte* pad);
+
+// Decodes "content" into "out", which has room for the "length" bytes of the original chunk.
+// "compressed" is as returned by EncodeChunk.
+void DecodeChunk(const byte* content, size_t content_size, ChunkCompression compression,
+                 bool compressed, const byte* key, const byte* iv, const byte* pad, byte* out,
+                 uint32_t length);
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_CHUNK_CODEC_H_
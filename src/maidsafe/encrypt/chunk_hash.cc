@@ -0,0 +1,99 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/chunk_hash.h"
+
+#include <limits>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/sha.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/encrypt/blake2bp.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+template <typename Hash>
+class ChunkHashOf : public ChunkHash {
+ public:
+  ChunkHashOf() : hash_() {}
+  void Update(const byte* data, size_t length) override { hash_.Update(data, length); }
+  void Final(byte* digest) override { hash_.Final(digest); }
+
+ private:
+  Hash hash_;
+};
+
+void CheckVersion(EncryptionAlgorithm version) {
+  if (!IsSelfEncryptionVersion(version)) {
+    LOG(kError) << "Unknown self-encryption version " << static_cast<uint32_t>(version);
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::invalid_encryption_version));
+  }
+}
+
+}  // unnamed namespace
+
+bool IsSelfEncryptionVersion(EncryptionAlgorithm version) {
+  return version == EncryptionAlgorithm::kSelfEncryptionVersion0 ||
+         version == EncryptionAlgorithm::kSelfEncryptionVersion1 ||
+         version == EncryptionAlgorithm::kSelfEncryptionVersion2;
+}
+
+uint32_t PreHashLength(EncryptionAlgorithm version) {
+  CheckVersion(version);
+  if (version == EncryptionAlgorithm::kSelfEncryptionVersion0)
+    return crypto::SHA512::DIGESTSIZE;
+  return std::numeric_limits<uint32_t>::max();
+}
+
+std::unique_ptr<ChunkHash> MakeChunkHash(EncryptionAlgorithm version) {
+  CheckVersion(version);
+  if (version == EncryptionAlgorithm::kSelfEncryptionVersion0)
+    return std::unique_ptr<ChunkHash>(new ChunkHashOf<CryptoPP::SHA512>);
+  return std::unique_ptr<ChunkHash>(new ChunkHashOf<Blake2bp>);
+}
+
+size_t ChunkHashBatchSize(EncryptionAlgorithm version) {
+  CheckVersion(version);
+  // BLAKE2bp is already parallel within each message
+  return version == EncryptionAlgorithm::kSelfEncryptionVersion0 ? Sha512Lanes() : 1;
+}
+
+void CalculateChunkHashes(EncryptionAlgorithm version, const HashJob* jobs, size_t count) {
+  CheckVersion(version);
+  if (version == EncryptionAlgorithm::kSelfEncryptionVersion0)
+    return Sha512Batch(jobs, count);
+  Blake2bp hash;
+  for (size_t i(0); i != count; ++i)
+    hash.CalculateDigest(jobs[i].digest, jobs[i].data, jobs[i].length);
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,68 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_CHUNK_HASH_H_
+#define MAIDSAFE_ENCRYPT_CHUNK_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/data_map.h"
+#include "maidsafe/encrypt/sha512_batch.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// The hash behind chunk pre-hashes and chunk names, which depends on the DataMap's self-encryption
+// version.  Every version's digests are 64 bytes.
+//   kSelfEncryptionVersion0: SHA-512, with each pre-hash covering only the first 64 bytes of its
+//                            chunk
+//   kSelfEncryptionVersion1: BLAKE2bp, with each pre-hash covering its whole chunk
+//   kSelfEncryptionVersion2: as version 1
+
+// True if "version" is a self-encryption version, rather than some other EncryptionAlgorithm
+bool IsSelfEncryptionVersion(EncryptionAlgorithm version);
+
+// How many bytes at the start of each chunk feed its pre-hash
+uint32_t PreHashLength(EncryptionAlgorithm version);
+
+// Incremental form of a version's hash
+class ChunkHash {
+ public:
+  virtual ~ChunkHash() {}
+  virtual void Update(const byte* data, size_t length) = 0;
+  // Writes the 64-byte digest of everything passed to Update and restarts
+  virtual void Final(byte* digest) = 0;
+};
+
+std::unique_ptr<ChunkHash> MakeChunkHash(EncryptionAlgorithm version);
+
+// How many messages CalculateChunkHashes hashes at once for "version", so callers can group work
+size_t ChunkHashBatchSize(EncryptionAlgorithm version);
+
+// Hashes each of the "count" messages using "version"'s hash
+void CalculateChunkHashes(EncryptionAlgorithm version, const HashJob* jobs, size_t count);
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_CHUNK_HASH_H_
@@ -0,0 +1,45 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/chunk_status_table.h"
+
+#include <algorithm>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+ChunkStatusTable::ChunkStatusTable() : statuses_(), size_(0), capacity_(0) {}
+
+void ChunkStatusTable::Resize(uint32_t size) {
+  if (size > capacity_) {
+    uint32_t capacity(std::max(size, capacity_ + capacity_ / 2));
+    std::unique_ptr<std::atomic<ChunkStatus>[]> statuses(new std::atomic<ChunkStatus>[capacity]);
+    for (uint32_t i(0); i != size_; ++i)
+      statuses[i].store(statuses_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    statuses_ = std::move(statuses);
+    capacity_ = capacity;
+  }
+  for (uint32_t i(size_); i < size; ++i)
+    statuses_[i].store(ChunkStatus::unused, std::memory_order_relaxed);
+  size_.store(size, std::memory_order_release);
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,82 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_CHUNK_STATUS_TABLE_H_
+#define MAIDSAFE_ENCRYPT_CHUNK_STATUS_TABLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+enum class ChunkStatus : uint8_t {
+  unused,  // not yet read or written
+  to_be_hashed,
+  to_be_encrypted,
+  stored,  // therefor only being used as read cache`
+  remote,
+  loading  // being read ahead in the background
+};
+
+// The status of each chunk of a SelfEncryptor, held densely by chunk number.  Individual statuses
+// can be read and updated from any thread without further locking, but Resize must not run
+// concurrently with any other member function unless Fits is true for the new size.
+class ChunkStatusTable {
+ public:
+  ChunkStatusTable();
+  ChunkStatusTable(const ChunkStatusTable&) = delete;
+  ChunkStatusTable(ChunkStatusTable&&) = delete;
+  ChunkStatusTable& operator=(ChunkStatusTable) = delete;
+
+  uint32_t size() const { return size_; }
+  // True if resizing to "size" won't reallocate the table
+  bool Fits(uint32_t size) const { return size <= capacity_; }
+  // Added chunks are unused.  The capacity grows geometrically, so appending chunk by chunk only
+  // reallocates occasionally.
+  void Resize(uint32_t size);
+
+  // Chunks beyond the end of the table are unused
+  ChunkStatus Get(uint32_t chunk_num) const {
+    return chunk_num < size_ ? statuses_[chunk_num].load(std::memory_order_acquire)
+                             : ChunkStatus::unused;
+  }
+  void Set(uint32_t chunk_num, ChunkStatus status) {
+    statuses_[chunk_num].store(status, std::memory_order_release);
+  }
+  // Sets the status of an unused chunk, returning the chunk's status afterwards
+  ChunkStatus Use(uint32_t chunk_num, ChunkStatus status) {
+    ChunkStatus current(ChunkStatus::unused);
+    return statuses_[chunk_num].compare_exchange_strong(current, status,
+                                                        std::memory_order_acq_rel) ?
+               status : current;
+  }
+
+ private:
+  std::unique_ptr<std::atomic<ChunkStatus>[]> statuses_;
+  std::atomic<uint32_t> size_;
+  uint32_t capacity_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_CHUNK_STATUS_TABLE_H_
@@ -0,0 +1,136 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/compression_policy.h"
+
+#include <algorithm>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+// Weight given to each new measurement of a level
+const double kSmoothing(0.25);
+// Chunks measured at the current level between decisions on whether to change it
+const unsigned kSamplesPerDecision(4);
+// The level only climbs while the cores beat the store by this margin, so that it doesn't climb
+// straight into the CPU limit
+const double kHeadroom(0.1);
+// After this many decisions without a change, a neighbouring level's measurement is considered
+// stale, and the level is tried again
+const unsigned kReprobeDecisions(8);
+
+}  // unnamed namespace
+
+CompressionPolicy::CompressionPolicy(int level)
+    : kAdaptive_(false),
+      kStoreBandwidth_(0.0),
+      kConcurrency_(0.0),
+      measurements_(),
+      level_(level),
+      samples_(0),
+      stays_(0),
+      mutex_() {
+  if (level < kFastestLevel || level > kBestLevel) {
+    LOG(kError) << "Invalid compression level " << level;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+}
+
+CompressionPolicy::CompressionPolicy(uint64_t store_bandwidth, unsigned concurrency)
+    : kAdaptive_(true),
+      kStoreBandwidth_(static_cast<double>(store_bandwidth)),
+      kConcurrency_(static_cast<double>(std::max(concurrency, 1U))),
+      measurements_(),
+      level_(kFastestLevel),
+      samples_(0),
+      stays_(0),
+      mutex_() {
+  if (store_bandwidth == 0) {
+    LOG(kError) << "Store bandwidth must be non-zero";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+}
+
+int CompressionPolicy::Level() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return level_;
+}
+
+void CompressionPolicy::Record(int level, uint64_t input_size, uint64_t output_size,
+                               std::chrono::nanoseconds duration) {
+  if (!kAdaptive_ || input_size == 0 || level < kFastestLevel || level > kBestLevel)
+    return;
+  double seconds(static_cast<double>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 1)) /
+                 1e9);
+  double speed(static_cast<double>(input_size) / seconds);
+  double ratio(std::max(static_cast<double>(output_size) / input_size, 1e-6));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Measurement& measurement(measurements_[level]);
+  if (measurement.valid) {
+    measurement.speed += kSmoothing * (speed - measurement.speed);
+    measurement.ratio += kSmoothing * (ratio - measurement.ratio);
+  } else {
+    measurement.valid = true;
+    measurement.speed = speed;
+    measurement.ratio = ratio;
+  }
+  // chunks started before the last change of level don't count towards the next decision
+  if (level != level_ || ++samples_ < kSamplesPerDecision)
+    return;
+
+  samples_ = 0;
+  double cpu_rate(measurement.speed * kConcurrency_);
+  double store_rate(kStoreBandwidth_ / measurement.ratio);
+  int next(level_);
+  if (cpu_rate > store_rate * (1.0 + kHeadroom)) {
+    if (level_ < kBestLevel && WorthTrying(level_ + 1))
+      next = level_ + 1;
+  } else if (cpu_rate < store_rate) {
+    if (level_ > kFastestLevel && WorthTrying(level_ - 1))
+      next = level_ - 1;
+  }
+  if (next == level_) {
+    ++stays_;
+  } else {
+    level_ = next;
+    stays_ = 0;
+  }
+}
+
+double CompressionPolicy::Throughput(int level) const {
+  const Measurement& measurement(measurements_[level]);
+  return std::min(measurement.speed * kConcurrency_, kStoreBandwidth_ / measurement.ratio);
+}
+
+bool CompressionPolicy::WorthTrying(int level) {
+  Measurement& measurement(measurements_[level]);
+  if (measurement.valid && stays_ >= kReprobeDecisions)
+    measurement.valid = false;
+  return !measurement.valid || Throughput(level) >= Throughput(level_);
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -26,6 +26,8 @@ namespace maidsafe {
 namespace encrypt {
 
 const uint32_t kMinChunkSize(1024);
+// Upper limit on the number of chunks read ahead of a sequential reader
+const uint32_t kMaxReadAheadChunks(16);
 using byte = unsigned char;
 using ByteVector = std::vector<byte>;
 
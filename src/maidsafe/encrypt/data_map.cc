@@ -28,29 +28,34 @@ namespace maidsafe {
 
 namespace encrypt {
 
-ChunkDetails::ChunkDetails(ChunkDetails&& other) MAIDSAFE_NOEXCEPT
-    : hash(std::move(other.hash)),
-      pre_hash(std::move(other.pre_hash)),
-      storage_state(std::move(other.storage_state)),
-      size(std::move(other.size)) {}
-
-ChunkDetails& ChunkDetails::operator=(ChunkDetails&& other) MAIDSAFE_NOEXCEPT {
-  hash = std::move(other.hash);
-  pre_hash = std::move(other.pre_hash);
-  storage_state = std::move(other.storage_state);
-  size = std::move(other.size);
-  return *this;
+ByteVector& ChunkDetails::SerialisationBuffer() {
+  static thread_local ByteVector buffer;
+  return buffer;
+}
+
+void ChunkDetails::LoadDigest(const ByteVector& buffer, ChunkDigest& digest) {
+  if (!buffer.empty() && buffer.size() != crypto::SHA512::DIGESTSIZE) {
+    LOG(kError) << "Chunk digest has invalid size " << buffer.size();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  }
+  digest.assign(std::begin(buffer), std::end(buffer));
 }
 
-DataMap::DataMap() : self_encryption_version(kSelfEncryptionVersion), chunks(), content() {}
+DataMap::DataMap()
+    : self_encryption_version(kSelfEncryptionVersion),
+      compression(ChunkCompression::kGzip),
+      chunks(),
+      content() {}
 
 DataMap::DataMap(DataMap&& other) MAIDSAFE_NOEXCEPT
     : self_encryption_version(std::move(other.self_encryption_version)),
+      compression(std::move(other.compression)),
       chunks(std::move(other.chunks)),
       content(std::move(other.content)) {}
 
 DataMap& DataMap::operator=(DataMap&& other) MAIDSAFE_NOEXCEPT {
   self_encryption_version = std::move(other.self_encryption_version);
+  compression = std::move(other.compression);
   chunks = std::move(other.chunks);
   content = std::move(other.content);
   return *this;
@@ -65,7 +70,8 @@ uint64_t DataMap::size() const {
 bool DataMap::empty() const { return chunks.empty() && content.empty(); }
 
 bool operator==(const DataMap& lhs, const DataMap& rhs) {
-  if (lhs.self_encryption_version != rhs.self_encryption_version || lhs.content != rhs.content ||
+  if (lhs.self_encryption_version != rhs.self_encryption_version ||
+      lhs.compression != rhs.compression || lhs.content != rhs.content ||
       lhs.chunks.size() != rhs.chunks.size()) {
     return false;
   }
@@ -29,9 +29,7 @@
 #ifdef __MSVC__
 #pragma warning(push, 1)
 #endif
-#include "cryptopp/aes.h"
 #include "cryptopp/gzip.h"
-#include "cryptopp/modes.h"
 #include "cryptopp/mqueue.h"
 #include "cryptopp/sha.h"
 #ifdef __MSVC__
@@ -48,6 +46,7 @@
 #include "maidsafe/common/utils.h"
 #include "maidsafe/common/serialisation/serialisation.h"
 
+#include "maidsafe/encrypt/aes_cfb.h"
 #include "maidsafe/encrypt/config.h"
 #include "maidsafe/encrypt/xor.h"
 #include "maidsafe/encrypt/data_map.h"
@@ -96,16 +95,13 @@ DataMap DecryptUsingVersion0(const Identity& parent_id, const Identity& this_id,
 
   ByteVector encryption_hash(GetEncryptionHash(parent_id, this_id));
   ByteVector xor_hash(GetXorHash(parent_id, this_id));
-  CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption decryptor(
-      &encryption_hash.data()[0], crypto::AES256_KeySize,
-      &encryption_hash.data()[crypto::AES256_KeySize]);
-
-  std::string serialised_data_map;
-  CryptoPP::StringSource filter(
-      encrypted_data_map_str, true,
-      new XORFilter(new CryptoPP::StreamTransformationFilter(
-                        decryptor, new CryptoPP::StringSink(serialised_data_map)),
-                    &xor_hash.data()[0], crypto::SHA512::DIGESTSIZE));
+  // XOR then decrypt, in place
+  std::string serialised_data_map(encrypted_data_map_str);
+  byte* data(reinterpret_cast<byte*>(&serialised_data_map[0]));
+  XorWithPad(data, data, serialised_data_map.size(), &xor_hash.data()[0],
+             crypto::SHA512::DIGESTSIZE, 0);
+  AesCfb(&encryption_hash.data()[0], &encryption_hash.data()[crypto::AES256_KeySize], false)
+      .ProcessData(data, data, serialised_data_map.size());
 
   return ConvertFromString<DataMap>(serialised_data_map);
 }
@@ -120,15 +116,13 @@ SerialisedData EncryptDataMap(const Identity& parent_id, const Identity& this_id
   SerialisedData serialised_data_map(Serialise(data_map));
   ByteVector encryption_hash(GetEncryptionHash(parent_id, this_id));
   ByteVector xor_hash(GetXorHash(parent_id, this_id));
-  CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption encryptor(
-      &encryption_hash.data()[0], crypto::AES256_KeySize,
-      &encryption_hash.data()[crypto::AES256_KeySize]);
-
-  std::string encrypted_data_map;
-  CryptoPP::StreamTransformationFilter aes_filter(
-      encryptor, new XORFilter(new CryptoPP::StringSink(encrypted_data_map), &xor_hash.data()[0],
-                               crypto::SHA512::DIGESTSIZE));
-  aes_filter.Put2(&serialised_data_map.data()[0], serialised_data_map.size(), -1, true);
+  // Encrypt then XOR, in place
+  std::string encrypted_data_map(serialised_data_map.begin(), serialised_data_map.end());
+  byte* data(reinterpret_cast<byte*>(&encrypted_data_map[0]));
+  AesCfb(&encryption_hash.data()[0], &encryption_hash.data()[crypto::AES256_KeySize], true)
+      .ProcessData(data, data, encrypted_data_map.size());
+  XorWithPad(data, data, encrypted_data_map.size(), &xor_hash.data()[0],
+             crypto::SHA512::DIGESTSIZE, 0);
 
   assert(!encrypted_data_map.empty());
 
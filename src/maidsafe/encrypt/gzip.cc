@@ -0,0 +1,643 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/gzip.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef MAIDSAFE_ENCRYPT_USE_LIBDEFLATE
+#include <memory>
+#include <new>
+
+#include "libdeflate.h"
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAIDSAFE_ENCRYPT_CRC_PCLMUL 1
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define MAIDSAFE_ENCRYPT_CRC_PCLMUL 1
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+uint32_t Read32(const byte* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// Tables for slicing-by-8: table k gives the CRC of a byte followed by k zero bytes
+CrcTables MakeCrcTables() {
+  CrcTables tables;
+  for (uint32_t i(0); i != 256; ++i) {
+    uint32_t crc(i);
+    for (int bit(0); bit != 8; ++bit)
+      crc = (crc & 1) ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+    tables[0][i] = crc;
+  }
+  for (uint32_t i(0); i != 256; ++i) {
+    for (size_t k(1); k != tables.size(); ++k)
+      tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xff];
+  }
+  return tables;
+}
+
+#ifdef MAIDSAFE_ENCRYPT_CRC_PCLMUL
+bool HasPclmul() {
+#ifdef __GNUC__
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("pclmul") != 0;
+#else
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 1)) != 0;
+#endif
+}
+
+#ifdef __GNUC__
+#define MAIDSAFE_ENCRYPT_CRC_TARGET __attribute__((target("pclmul,sse2")))
+#else
+#define MAIDSAFE_ENCRYPT_CRC_TARGET
+#endif
+
+MAIDSAFE_ENCRYPT_CRC_TARGET
+__m128i Load128(const byte* data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+// Folds "lane" forward by the distance the constants were computed for, onto "next"
+MAIDSAFE_ENCRYPT_CRC_TARGET
+__m128i Fold(__m128i lane, __m128i constants, __m128i next) {
+  return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(lane, constants, 0x00),
+                                     _mm_clmulepi64_si128(lane, constants, 0x11)),
+                       next);
+}
+
+// Continues "crc" over the "length" bytes at "data", which must be a multiple of 16 and at least
+// 64, by folding four 128-bit lanes at a time with carry-less multiplication and finishing with a
+// Barrett reduction, as in Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+// Instruction".  The constants are for the bit-reflected gzip polynomial.
+MAIDSAFE_ENCRYPT_CRC_TARGET
+uint32_t Crc32Pclmul(uint32_t crc, const byte* data, size_t length) {
+  const __m128i kFold64(_mm_set_epi64x(0x01c6e41596, 0x0154442bd4));
+  const __m128i kFold16(_mm_set_epi64x(0x00ccaa009e, 0x01751997d0));
+  const __m128i kFold4(_mm_set_epi64x(0, 0x0163cd6124));
+  const __m128i kBarrett(_mm_set_epi64x(0x01f7011641, 0x01db710641));
+  const __m128i kLow32(_mm_setr_epi32(~0, 0, ~0, 0));
+
+  __m128i lanes[4] = {_mm_xor_si128(Load128(data), _mm_cvtsi32_si128(static_cast<int>(crc))),
+                      Load128(data + 16), Load128(data + 32), Load128(data + 48)};
+  for (data += 64, length -= 64; length >= 64; data += 64, length -= 64) {
+    for (int i(0); i != 4; ++i)
+      lanes[i] = Fold(lanes[i], kFold64, Load128(data + 16 * i));
+  }
+  __m128i folded(lanes[0]);
+  for (int i(1); i != 4; ++i)
+    folded = Fold(folded, kFold16, lanes[i]);
+  for (; length >= 16; data += 16, length -= 16)
+    folded = Fold(folded, kFold16, Load128(data));
+
+  // 128 bits down to 64, then to 32
+  folded = _mm_xor_si128(_mm_srli_si128(folded, 8), _mm_clmulepi64_si128(folded, kFold16, 0x10));
+  folded = _mm_xor_si128(_mm_srli_si128(folded, 4),
+                         _mm_clmulepi64_si128(_mm_and_si128(folded, kLow32), kFold4, 0x00));
+  __m128i reduced(_mm_clmulepi64_si128(_mm_and_si128(folded, kLow32), kBarrett, 0x10));
+  reduced = _mm_clmulepi64_si128(_mm_and_si128(reduced, kLow32), kBarrett, 0x00);
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(_mm_xor_si128(folded, reduced),
+                                                                 4)));
+}
+#endif
+
+#ifndef MAIDSAFE_ENCRYPT_USE_LIBDEFLATE
+
+// gzip header (RFC 1952 section 2.3)
+const byte kId1(0x1f), kId2(0x8b), kDeflate(8);
+const byte kFlagHeaderCrc(0x02), kFlagExtra(0x04), kFlagName(0x08), kFlagComment(0x10);
+const byte kReservedFlags(0xe0);
+const size_t kHeaderSize(10), kTrailerSize(8);
+
+// Deflate (RFC 1951) limits
+const int kMaxCodeLength(15);
+const size_t kMaxLiteralCodes(286), kMaxDistanceCodes(30), kFixedLiteralCodes(288);
+const size_t kCodeLengthCodes(19);
+const byte kCodeLengthOrder[kCodeLengthCodes] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                                                 11, 4, 12, 3, 13, 2, 14, 1, 15};
+const uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const byte kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const byte kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Codes up to this long are decoded with a single table lookup; longer ones are rare enough to be
+// decoded a bit at a time
+const int kLiteralTableBits(12), kDistanceTableBits(9), kCodeLengthTableBits(7);
+// The most bits a length code and distance code take with their extra bits
+const int kMatchBits(kMaxCodeLength + 5 + kMaxCodeLength + 13);
+
+// Each decoded symbol is represented by an entry packing everything needed to act on it: the length
+// of its code in the low four bits, flags, the number of extra bits which follow the code and, in
+// the top half, the literal byte, base match length or base distance.
+const uint32_t kLiteralFlag(0x10), kEndFlag(0x20), kInvalidFlag(0x40);
+
+uint32_t MakeEntry(uint32_t value, uint32_t extra_bits, uint32_t flags) {
+  return value << 16 | extra_bits << 8 | flags;
+}
+
+int CodeLength(uint32_t entry) { return static_cast<int>(entry & 0xf); }
+int ExtraBits(uint32_t entry) { return static_cast<int>((entry >> 8) & 0xff); }
+uint32_t Value(uint32_t entry) { return entry >> 16; }
+
+enum class Alphabet { kCodeLengths, kLiterals, kDistances };
+
+uint32_t SymbolEntry(Alphabet alphabet, uint32_t symbol) {
+  switch (alphabet) {
+    case Alphabet::kCodeLengths:
+      return MakeEntry(symbol, 0, 0);
+    case Alphabet::kLiterals:
+      if (symbol < 256)
+        return MakeEntry(symbol, 0, kLiteralFlag);
+      if (symbol == 256)
+        return MakeEntry(0, 0, kEndFlag);
+      symbol -= 257;
+      return symbol < 29 ? MakeEntry(kLengthBase[symbol], kLengthExtra[symbol], 0) :
+                           MakeEntry(0, 0, kInvalidFlag);
+    default:
+      return symbol < kMaxDistanceCodes ?
+                 MakeEntry(kDistanceBase[symbol], kDistanceExtra[symbol], 0) :
+                 MakeEntry(0, 0, kInvalidFlag);
+  }
+}
+
+uint64_t Read64(const byte* data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// A canonical Huffman code.  The table, indexed by the next "table_bits" bits of input, holds the
+// entry for each code up to that long, and zero where a code is longer, in which case the counts
+// and entries ordered by code are walked a bit at a time.
+struct Huffman {
+  int table_bits;
+  std::array<uint16_t, kMaxCodeLength + 1> counts;
+  std::array<uint32_t, kFixedLiteralCodes> entries;
+  std::array<uint32_t, 1 << kLiteralTableBits> table;
+};
+
+uint32_t ReverseBits(uint32_t code, int length) {
+  uint32_t reversed(0);
+  for (int i(0); i != length; ++i, code >>= 1)
+    reversed = (reversed << 1) | (code & 1);
+  return reversed;
+}
+
+// Builds the code for the "count" symbols with the given code lengths.  Returns a negative value if
+// the lengths are over-subscribed, zero if they form a complete code, or the number of unused codes
+// of the longest length otherwise.
+int BuildHuffman(const byte* lengths, size_t count, Alphabet alphabet, int table_bits,
+                 Huffman& huffman) {
+  huffman.counts.fill(0);
+  for (size_t symbol(0); symbol != count; ++symbol)
+    ++huffman.counts[lengths[symbol]];
+  huffman.counts[0] = 0;
+  int left(1);
+  for (int length(1); length <= kMaxCodeLength; ++length) {
+    left = (left << 1) - huffman.counts[length];
+    if (left < 0)
+      return left;
+  }
+
+  std::array<uint16_t, kMaxCodeLength + 1> offsets;
+  offsets[1] = 0;
+  for (int length(1); length != kMaxCodeLength; ++length)
+    offsets[length + 1] = offsets[length] + huffman.counts[length];
+  for (size_t symbol(0); symbol != count; ++symbol) {
+    if (lengths[symbol] != 0) {
+      huffman.entries[offsets[lengths[symbol]]++] =
+          SymbolEntry(alphabet, static_cast<uint32_t>(symbol));
+    }
+  }
+
+  huffman.table_bits = table_bits;
+  const uint32_t kTableSize(1U << table_bits);
+  std::fill(std::begin(huffman.table), std::begin(huffman.table) + kTableSize, 0);
+  uint32_t code(0);
+  size_t index(0);
+  for (int length(1); length <= table_bits; ++length, code <<= 1) {
+    for (uint16_t i(0); i != huffman.counts[length]; ++i, ++code) {
+      uint32_t entry(huffman.entries[index++] | static_cast<uint32_t>(length));
+      for (uint32_t slot(ReverseBits(code, length)); slot < kTableSize; slot += 1U << length)
+        huffman.table[slot] = entry;
+    }
+  }
+  return left;
+}
+
+struct FixedHuffman {
+  FixedHuffman() {
+    std::array<byte, kFixedLiteralCodes> lengths;
+    std::fill(std::begin(lengths), std::begin(lengths) + 144, 8);
+    std::fill(std::begin(lengths) + 144, std::begin(lengths) + 256, 9);
+    std::fill(std::begin(lengths) + 256, std::begin(lengths) + 280, 7);
+    std::fill(std::begin(lengths) + 280, std::end(lengths), 8);
+    BuildHuffman(lengths.data(), lengths.size(), Alphabet::kLiterals, kLiteralTableBits, literals);
+    // the two unused distance codes are included, and decode as invalid
+    std::fill(std::begin(lengths), std::begin(lengths) + 32, 5);
+    BuildHuffman(lengths.data(), 32, Alphabet::kDistances, kDistanceTableBits, distances);
+  }
+  Huffman literals, distances;
+};
+
+// Decodes a raw deflate stream from one buffer into another.  Input is read through a 64-bit bit
+// buffer refilled a word at a time, and, once fewer than eight bytes remain, a byte at a time with
+// zeros counted in "overrun_" standing in for bytes beyond the end.
+class Inflater {
+ public:
+  Inflater(const byte* in, size_t in_size, byte* out, size_t out_size)
+      : in_(in), in_end_(in + in_size), out_(out), out_begin_(out), out_end_(out + out_size),
+        bits_(0), bit_count_(0), overrun_(0) {}
+  Inflater(const Inflater&) = delete;
+  Inflater& operator=(const Inflater&) = delete;
+
+  // Returns false if the stream is malformed or would overflow the output
+  bool Inflate();
+  // Once Inflate has succeeded, the input following the stream
+  const byte* in() const { return in_; }
+  size_t written() const { return out_ - out_begin_; }
+
+ private:
+  // Tops the bit buffer up to at least 56 bits
+  void Refill() {
+    if (in_end_ - in_ >= 8) {
+      bits_ |= Read64(in_) << bit_count_;
+      in_ += (63 - bit_count_) >> 3;
+      bit_count_ |= 56;
+      return;
+    }
+    while (bit_count_ < 56) {
+      if (in_ != in_end_)
+        bits_ |= static_cast<uint64_t>(*in_++) << bit_count_;
+      else
+        ++overrun_;
+      bit_count_ += 8;
+    }
+  }
+  uint32_t Take(int count) {
+    uint32_t value(static_cast<uint32_t>(bits_ & ((1ULL << count) - 1)));
+    bits_ >>= count;
+    bit_count_ -= count;
+    return value;
+  }
+  // True if more bits have been taken than the input held
+  bool Overrun() const { return overrun_ * 8 > bit_count_; }
+  // Discards bits up to the next byte boundary and returns any whole bytes still buffered to the
+  // input
+  bool AlignToByte();
+  // Takes the next code, returning its entry, which has kInvalidFlag set if the code isn't part of
+  // "huffman"
+  uint32_t Decode(const Huffman& huffman) {
+    uint32_t entry(huffman.table[bits_ & ((1U << huffman.table_bits) - 1)]);
+    if (entry == 0)
+      entry = DecodeLong(huffman);
+    Take(CodeLength(entry));
+    return entry;
+  }
+  uint32_t DecodeLong(const Huffman& huffman) const;
+  bool Stored();
+  bool Dynamic();
+  bool Codes(const Huffman& literals, const Huffman& distances);
+  void Copy(size_t distance, size_t length);
+
+  const byte* in_;
+  const byte* const in_end_;
+  byte* out_;
+  byte* const out_begin_;
+  byte* const out_end_;
+  uint64_t bits_;
+  int bit_count_;
+  int overrun_;
+};
+
+bool Inflater::Inflate() {
+  static const FixedHuffman kFixed;
+  bool last(false);
+  while (!last) {
+    Refill();
+    last = Take(1) != 0;
+    switch (Take(2)) {
+      case 0:
+        if (!Stored())
+          return false;
+        break;
+      case 1:
+        if (!Codes(kFixed.literals, kFixed.distances))
+          return false;
+        break;
+      case 2:
+        if (!Dynamic())
+          return false;
+        break;
+      default:
+        return false;
+    }
+    if (Overrun())
+      return false;
+  }
+  return AlignToByte();
+}
+
+bool Inflater::AlignToByte() {
+  bit_count_ -= bit_count_ & 7;
+  if (Overrun())
+    return false;
+  in_ -= bit_count_ / 8 - overrun_;
+  bits_ = 0;
+  bit_count_ = 0;
+  overrun_ = 0;
+  return true;
+}
+
+uint32_t Inflater::DecodeLong(const Huffman& huffman) const {
+  // codes are stored most significant bit first, so build them up a bit at a time, comparing with
+  // the first code of each length
+  int code(0), first(0), index(0);
+  for (int length(1); length <= kMaxCodeLength; ++length) {
+    code |= static_cast<int>((bits_ >> (length - 1)) & 1);
+    int count(huffman.counts[length]);
+    if (code - first < count)
+      return huffman.entries[index + code - first] | static_cast<uint32_t>(length);
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  return kInvalidFlag;
+}
+
+bool Inflater::Stored() {
+  if (!AlignToByte() || in_end_ - in_ < 4)
+    return false;
+  size_t length(in_[0] | in_[1] << 8), complement(in_[2] | in_[3] << 8);
+  in_ += 4;
+  if (length != (~complement & 0xffff) || length > static_cast<size_t>(in_end_ - in_) ||
+      length > static_cast<size_t>(out_end_ - out_))
+    return false;
+  std::memcpy(out_, in_, length);
+  in_ += length;
+  out_ += length;
+  return true;
+}
+
+bool Inflater::Dynamic() {
+  Refill();
+  size_t literal_count(Take(5) + 257), distance_count(Take(5) + 1);
+  size_t code_length_count(Take(4) + 4);
+  if (literal_count > kMaxLiteralCodes || distance_count > kMaxDistanceCodes)
+    return false;
+
+  std::array<byte, kMaxLiteralCodes + kMaxDistanceCodes> lengths;
+  lengths.fill(0);
+  for (size_t i(0); i != code_length_count; ++i) {
+    Refill();
+    lengths[kCodeLengthOrder[i]] = static_cast<byte>(Take(3));
+  }
+  Huffman code_lengths;
+  if (BuildHuffman(lengths.data(), kCodeLengthCodes, Alphabet::kCodeLengths,
+                   kCodeLengthTableBits, code_lengths) != 0)
+    return false;
+
+  size_t total(literal_count + distance_count), index(0);
+  while (index < total) {
+    Refill();
+    uint32_t entry(Decode(code_lengths));
+    if (entry & kInvalidFlag)
+      return false;
+    uint32_t symbol(Value(entry));
+    if (symbol < 16) {
+      lengths[index++] = static_cast<byte>(symbol);
+      continue;
+    }
+    byte repeated(0);
+    size_t repeats(0);
+    if (symbol == 16) {
+      if (index == 0)
+        return false;
+      repeated = lengths[index - 1];
+      repeats = 3 + Take(2);
+    } else if (symbol == 17) {
+      repeats = 3 + Take(3);
+    } else {
+      repeats = 11 + Take(7);
+    }
+    if (index + repeats > total)
+      return false;
+    std::fill(std::begin(lengths) + index, std::begin(lengths) + index + repeats, repeated);
+    index += repeats;
+  }
+  if (Overrun() || lengths[256] == 0)
+    return false;
+
+  // an incomplete code is only allowed if it has a single code of length one, or for distances, if
+  // it has no codes at all, as in a block of only literals; any match then fails to decode
+  Huffman literals, distances;
+  int left(BuildHuffman(lengths.data(), literal_count, Alphabet::kLiterals, kLiteralTableBits,
+                        literals));
+  if (left < 0 || (left > 0 && literals.counts[1] != 1))
+    return false;
+  left = BuildHuffman(lengths.data() + literal_count, distance_count, Alphabet::kDistances,
+                      kDistanceTableBits, distances);
+  if (left < 0 || (left > 0 && distances.counts[1] != 1 && left != 1 << kMaxCodeLength))
+    return false;
+  return Codes(literals, distances);
+}
+
+bool Inflater::Codes(const Huffman& literals, const Huffman& distances) {
+  for (;;) {
+    // a refill leaves room for three literal codes, so runs of literals are written two at a time
+    // without checking the bit count
+    Refill();
+    uint32_t entry(Decode(literals));
+    if (entry & kLiteralFlag) {
+      if (out_end_ - out_ < 3) {
+        if (out_ == out_end_)
+          return false;
+        *out_++ = static_cast<byte>(Value(entry));
+        continue;
+      }
+      *out_++ = static_cast<byte>(Value(entry));
+      entry = Decode(literals);
+      if (entry & kLiteralFlag) {
+        *out_++ = static_cast<byte>(Value(entry));
+        entry = Decode(literals);
+        if (entry & kLiteralFlag) {
+          *out_++ = static_cast<byte>(Value(entry));
+          continue;
+        }
+      }
+    }
+    if (entry & (kEndFlag | kInvalidFlag))
+      return (entry & kInvalidFlag) == 0;
+
+    if (bit_count_ < kMatchBits)
+      Refill();
+    size_t length(Value(entry) + Take(ExtraBits(entry)));
+    entry = Decode(distances);
+    if (entry & kInvalidFlag)
+      return false;
+    size_t distance(Value(entry) + Take(ExtraBits(entry)));
+    if (distance > static_cast<size_t>(out_ - out_begin_) ||
+        length > static_cast<size_t>(out_end_ - out_))
+      return false;
+    Copy(distance, length);
+  }
+}
+
+void Inflater::Copy(size_t distance, size_t length) {
+  const byte* from(out_ - distance);
+  byte* to(out_);
+  out_ += length;
+  if (out_end_ - out_ >= 8) {
+    // whole words, possibly running up to seven bytes past the match into space not yet written
+    if (distance >= 8) {
+      while (to < out_) {
+        std::memcpy(to, from, 8);
+        to += 8;
+        from += 8;
+      }
+      return;
+    }
+    if (distance == 1) {
+      std::memset(to, *from, length);
+      return;
+    }
+  }
+  // overlapping matches repeat the bytes just written
+  while (to != out_)
+    *to++ = *from++;
+}
+
+#else
+
+struct DecompressorDeleter {
+  void operator()(libdeflate_decompressor* decompressor) const {
+    libdeflate_free_decompressor(decompressor);
+  }
+};
+
+#endif
+
+}  // unnamed namespace
+
+#ifndef MAIDSAFE_ENCRYPT_USE_LIBDEFLATE
+
+const char* GzipBackend() { return "built-in inflate"; }
+
+bool GzipDecompress(const byte* in, size_t in_size, byte* out, size_t out_size) {
+  if (in_size < kHeaderSize + kTrailerSize || in[0] != kId1 || in[1] != kId2 ||
+      in[2] != kDeflate || (in[3] & kReservedFlags) != 0)
+    return false;
+  const byte flags(in[3]);
+  const byte* position(in + kHeaderSize);
+  const byte* const trailer(in + in_size - kTrailerSize);
+  if (flags & kFlagExtra) {
+    if (trailer - position < 2)
+      return false;
+    size_t extra_length(position[0] | position[1] << 8);
+    position += 2;
+    if (static_cast<size_t>(trailer - position) < extra_length)
+      return false;
+    position += extra_length;
+  }
+  for (byte flag : {kFlagName, kFlagComment}) {
+    if (flags & flag) {
+      position = static_cast<const byte*>(std::memchr(position, 0, trailer - position));
+      if (!position)
+        return false;
+      ++position;
+    }
+  }
+  if (flags & kFlagHeaderCrc) {
+    if (trailer - position < 2)
+      return false;
+    position += 2;
+  }
+
+  Inflater inflater(position, trailer - position, out, out_size);
+  return inflater.Inflate() && inflater.in() == trailer && inflater.written() == out_size &&
+         Read32(trailer) == Crc32(out, out_size) &&
+         Read32(trailer + 4) == static_cast<uint32_t>(out_size);
+}
+
+#else
+
+const char* GzipBackend() { return "libdeflate"; }
+
+bool GzipDecompress(const byte* in, size_t in_size, byte* out, size_t out_size) {
+  thread_local std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor;
+  if (!decompressor) {
+    decompressor.reset(libdeflate_alloc_decompressor());
+    if (!decompressor)
+      throw std::bad_alloc();
+  }
+  // with no actual size requested, anything other than exactly "out_size" bytes fails
+  return libdeflate_gzip_decompress(decompressor.get(), in, in_size, out, out_size, nullptr) ==
+         LIBDEFLATE_SUCCESS;
+}
+
+#endif
+
+uint32_t Crc32(const byte* data, size_t length) {
+  static const CrcTables kTables(MakeCrcTables());
+  uint32_t crc(0xffffffff);
+#ifdef MAIDSAFE_ENCRYPT_CRC_PCLMUL
+  static const bool kPclmul(HasPclmul());
+  if (kPclmul && length >= 64) {
+    size_t folded(length & ~static_cast<size_t>(15));
+    crc = Crc32Pclmul(crc, data, folded);
+    data += folded;
+    length -= folded;
+  }
+#endif
+  for (; length >= 8; length -= 8, data += 8) {
+    uint32_t low(Read32(data) ^ crc), high(Read32(data + 4));
+    crc = kTables[7][low & 0xff] ^ kTables[6][(low >> 8) & 0xff] ^
+          kTables[5][(low >> 16) & 0xff] ^ kTables[4][low >> 24] ^ kTables[3][high & 0xff] ^
+          kTables[2][(high >> 8) & 0xff] ^ kTables[1][(high >> 16) & 0xff] ^
+          kTables[0][high >> 24];
+  }
+  for (; length != 0; --length, ++data)
+    crc = kTables[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
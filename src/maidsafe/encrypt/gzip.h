@@ -0,0 +1,52 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_GZIP_H_
+#define MAIDSAFE_ENCRYPT_GZIP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "maidsafe/encrypt/config.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Whole-buffer decompression in the gzip format (RFC 1952) for chunks compressed with kGzip.
+// Compression always stays with CryptoPP's Gzip, since the content and names of chunks depend on
+// its exact output.  Decompression uses the table-driven inflater here, which reads the whole
+// stream at once rather than through CryptoPP's filters, or libdeflate's if built with
+// MAIDSAFE_ENCRYPT_USE_LIBDEFLATE.  Either way, every chunk decompresses the same.
+
+// Names the decompressor chosen at build time
+const char* GzipBackend();
+
+// Decompresses the single gzip member held in the "in_size" bytes at "in" into the "out_size"
+// bytes at "out".  Returns false if the input is malformed, fails its CRC check or doesn't
+// decompress to exactly "out_size" bytes.
+bool GzipDecompress(const byte* in, size_t in_size, byte* out, size_t out_size);
+
+// The CRC-32 of the "length" bytes at "data", as recorded in gzip trailers
+uint32_t Crc32(const byte* data, size_t length);
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_GZIP_H_
@@ -0,0 +1,192 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+const size_t kMinMatch(4);
+// The last five bytes are always literals, and the last match must start at least twelve bytes
+// before the end
+const size_t kLastLiterals(5), kMatchStartLimit(12);
+const size_t kMaxOffset(65535);
+const int kHashBits(14);
+// After this many consecutive misses, the compressor starts skipping bytes between probes
+const int kSkipTrigger(6);
+
+uint32_t Read32(const byte* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint64_t Read64(const byte* data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - kHashBits); }
+
+// Writes the 255-byte continuation of a length whose 4-bit field in the token was saturated
+byte* WriteLength(byte* out, size_t length) {
+  for (; length >= 255; length -= 255)
+    *out++ = 255;
+  *out++ = static_cast<byte>(length);
+  return out;
+}
+
+// Reads the continuation of a saturated length, returning false if it runs off the input
+bool ReadLength(const byte*& in, const byte* in_end, size_t& length) {
+  byte value(255);
+  while (value == 255) {
+    if (in == in_end)
+      return false;
+    value = *in++;
+    length += value;
+  }
+  return true;
+}
+
+byte* WriteSequence(byte* out, const byte* literals, size_t literal_length, size_t offset,
+                    size_t match_length) {
+  byte* token(out++);
+  *token = static_cast<byte>((literal_length < 15 ? literal_length : 15) << 4);
+  if (literal_length >= 15)
+    out = WriteLength(out, literal_length - 15);
+  std::memcpy(out, literals, literal_length);
+  out += literal_length;
+  if (match_length == 0)
+    return out;
+  *out++ = static_cast<byte>(offset);
+  *out++ = static_cast<byte>(offset >> 8);
+  match_length -= kMinMatch;
+  *token |= static_cast<byte>(match_length < 15 ? match_length : 15);
+  if (match_length >= 15)
+    out = WriteLength(out, match_length - 15);
+  return out;
+}
+
+}  // unnamed namespace
+
+size_t Lz4CompressBound(size_t length) { return length + length / 255 + 16; }
+
+size_t Lz4Compress(const byte* in, size_t length, byte* out) {
+  const byte* const in_end(in + length);
+  const byte* anchor(in);  // start of the pending literals
+  byte* op(out);
+  if (length > kMatchStartLimit) {
+    const byte* const match_start_limit(in_end - kMatchStartLimit);
+    const byte* const match_end_limit(in_end - kLastLiterals);
+    std::vector<uint32_t> table(static_cast<size_t>(1) << kHashBits, 0);
+    const byte* ip(in);
+    unsigned misses(0);
+    while (ip <= match_start_limit) {
+      uint32_t sequence(Read32(ip));
+      uint32_t& entry(table[Hash(sequence)]);
+      const byte* candidate(in + entry);
+      entry = static_cast<uint32_t>(ip - in);
+      if (candidate >= ip || static_cast<size_t>(ip - candidate) > kMaxOffset ||
+          Read32(candidate) != sequence) {
+        ip += 1 + (misses++ >> kSkipTrigger);
+        continue;
+      }
+      misses = 0;
+      // extend the match backwards over the pending literals, then forwards
+      while (ip > anchor && candidate > in && ip[-1] == candidate[-1]) {
+        --ip;
+        --candidate;
+      }
+      const byte* match_end(ip + kMinMatch);
+      const byte* reference(candidate + kMinMatch);
+      while (match_end + sizeof(uint64_t) <= match_end_limit &&
+             Read64(match_end) == Read64(reference)) {
+        match_end += sizeof(uint64_t);
+        reference += sizeof(uint64_t);
+      }
+      while (match_end < match_end_limit && *match_end == *reference) {
+        ++match_end;
+        ++reference;
+      }
+      op = WriteSequence(op, anchor, static_cast<size_t>(ip - anchor),
+                         static_cast<size_t>(ip - candidate), static_cast<size_t>(match_end - ip));
+      anchor = ip = match_end;
+    }
+  }
+  return static_cast<size_t>(
+      WriteSequence(op, anchor, static_cast<size_t>(in_end - anchor), 0, 0) - out);
+}
+
+bool Lz4Decompress(const byte* in, size_t in_size, byte* out, size_t out_size) {
+  const byte* const in_end(in + in_size);
+  byte* const out_end(out + out_size);
+  byte* op(out);
+  for (;;) {
+    if (in == in_end)
+      return false;
+    byte token(*in++);
+    size_t literal_length(token >> 4);
+    if (literal_length == 15 && !ReadLength(in, in_end, literal_length))
+      return false;
+    if (literal_length > static_cast<size_t>(in_end - in) ||
+        literal_length > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+    std::memcpy(op, in, literal_length);
+    op += literal_length;
+    in += literal_length;
+    // the last sequence is literals alone
+    if (in == in_end)
+      return op == out_end;
+
+    if (in_end - in < 2)
+      return false;
+    size_t offset(in[0] | (static_cast<size_t>(in[1]) << 8));
+    in += 2;
+    size_t match_length(token & 15);
+    if (match_length == 15 && !ReadLength(in, in_end, match_length))
+      return false;
+    match_length += kMinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(op - out) ||
+        match_length > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+    // A match overlapping the bytes it produces repeats the last "offset" bytes.  Each copy takes
+    // a whole number of repeats from before "op", so the copies never overlap and double in size.
+    const byte* match(op - offset);
+    for (size_t copied(0); copied != match_length;) {
+      size_t count(std::min(match_length - copied, offset + copied));
+      std::memcpy(op + copied, match, count);
+      copied += count;
+    }
+    op += match_length;
+  }
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,50 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_LZ4_H_
+#define MAIDSAFE_ENCRYPT_LZ4_H_
+
+#include <cstddef>
+
+#include "maidsafe/encrypt/config.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Compression and decompression of single blocks in the LZ4 block format
+// (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).  The compressor is the greedy,
+// single-probe kind used by LZ4's fast mode, skipping ahead faster the longer it goes without a
+// match, so that incompressible input costs little.  Blocks are limited to 2GiB.
+
+// The most that Lz4Compress can write for "length" bytes of input
+size_t Lz4CompressBound(size_t length);
+
+// Compresses the "length" bytes at "in" into "out", which must have room for
+// Lz4CompressBound(length) bytes, returning the compressed size
+size_t Lz4Compress(const byte* in, size_t length, byte* out);
+
+// Decompresses the "in_size" bytes at "in" into the "out_size" bytes at "out".  Returns false if
+// the input is malformed or doesn't decompress to exactly "out_size" bytes.
+bool Lz4Decompress(const byte* in, size_t in_size, byte* out, size_t out_size);
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_LZ4_H_
@@ -0,0 +1,122 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/pre_hash_tracker.h"
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+namespace maidsafe {
+
+namespace encrypt {
+
+PreHashTracker::PreHashTracker(uint32_t prefix_length, EncryptionAlgorithm version,
+                               size_t max_live_streams)
+    : kVersion_(version),
+      kPrefixLength_(prefix_length),
+      kMaxLiveStreams_(std::max<size_t>(max_live_streams, 1)),
+      streams_(),
+      live_streams_(0) {}
+
+void PreHashTracker::Write(const byte* data, uint32_t length, uint64_t position,
+                           uint64_t chunk_start) {
+  if (length == 0)
+    return;
+  // discard any streams whose hashed bytes this overwrites; only the stream of the chunk containing
+  // "position" and those starting within the write can overlap it
+  uint64_t end(position + length);
+  auto itr(streams_.upper_bound(position));
+  if (itr != std::begin(streams_))
+    --itr;
+  while (itr != std::end(streams_) && itr->first < end) {
+    if (itr->second.end > position)
+      itr = Erase(itr);
+    else
+      ++itr;
+  }
+
+  // continue the chunk's stream, or start one if this is the chunk's first byte
+  uint64_t prefix_end(chunk_start + kPrefixLength_);
+  if (position >= prefix_end)
+    return;
+  itr = streams_.find(chunk_start);
+  if (itr == std::end(streams_)) {
+    if (position != chunk_start)
+      return;
+    itr = streams_.emplace_hint(itr, std::piecewise_construct, std::forward_as_tuple(chunk_start),
+                                std::forward_as_tuple(kVersion_));
+    itr->second.end = chunk_start;
+    ++live_streams_;
+    LimitLiveStreams();
+    itr = streams_.find(chunk_start);
+    if (itr == std::end(streams_))
+      return;
+  }
+  if (itr->second.end != position)
+    return;
+  auto count(static_cast<uint32_t>(std::min<uint64_t>(length, prefix_end - position)));
+  itr->second.hash->Update(data, count);
+  itr->second.end += count;
+  if (itr->second.end == prefix_end) {
+    itr->second.hash->Final(itr->second.digest.data());
+    itr->second.hash.reset();
+    --live_streams_;
+  }
+}
+
+void PreHashTracker::Truncate(uint64_t position) {
+  for (auto itr(std::begin(streams_)); itr != std::end(streams_);) {
+    if (itr->second.end > position)
+      itr = Erase(itr);
+    else
+      ++itr;
+  }
+}
+
+bool PreHashTracker::Finish(uint64_t chunk_start, uint64_t chunk_end, byte* digest) {
+  auto itr(streams_.find(chunk_start));
+  if (itr == std::end(streams_))
+    return false;
+  bool complete(itr->second.end == std::min(chunk_end, chunk_start + kPrefixLength_));
+  if (complete && itr->second.hash)
+    itr->second.hash->Final(digest);
+  else if (complete)
+    std::copy(std::begin(itr->second.digest), std::end(itr->second.digest), digest);
+  Erase(itr);
+  return complete;
+}
+
+PreHashTracker::StreamIterator PreHashTracker::Erase(StreamIterator itr) {
+  if (itr->second.hash)
+    --live_streams_;
+  return streams_.erase(itr);
+}
+
+void PreHashTracker::LimitLiveStreams() {
+  for (auto itr(std::begin(streams_)); live_streams_ > kMaxLiveStreams_;) {
+    if (itr->second.hash)
+      itr = Erase(itr);
+    else
+      ++itr;
+  }
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
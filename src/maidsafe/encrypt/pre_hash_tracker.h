@@ -0,0 +1,87 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_PRE_HASH_TRACKER_H_
+#define MAIDSAFE_ENCRYPT_PRE_HASH_TRACKER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include "maidsafe/encrypt/chunk_hash.h"
+#include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/data_map.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Accumulates chunk pre-hashes as sequential writes fill the chunks, so that Close needn't read the
+// data back to hash it.  Each chunk's pre-hash covers its first "prefix_length" bytes, or the whole
+// chunk if shorter.  Chunks are identified by their start positions, since chunk numbers and
+// boundaries change as the file grows; a stream simply holds the hash of the file's bytes from the
+// chunk's start up to where it has reached, and any write or truncation altering those bytes
+// discards it.  Chunks written out of order aren't tracked, and so are hashed in full by Close.
+//
+// A stream whose prefix is complete keeps only its digest.  At most "max_live_streams" streams
+// hold a hashing state at once; beyond that the one starting lowest in the file, which for
+// sequential writes is the oldest, is discarded and its chunk left for Close to hash.
+class PreHashTracker {
+ public:
+  PreHashTracker(uint32_t prefix_length, EncryptionAlgorithm version, size_t max_live_streams);
+  PreHashTracker(const PreHashTracker&) = delete;
+  PreHashTracker(PreHashTracker&&) = delete;
+  PreHashTracker& operator=(PreHashTracker) = delete;
+
+  // Records that "length" bytes were written at "position", all within the chunk currently
+  // starting at "chunk_start"
+  void Write(const byte* data, uint32_t length, uint64_t position, uint64_t chunk_start);
+  // Records that the file was truncated to "position"
+  void Truncate(uint64_t position);
+  // If the pre-hash of the chunk [chunk_start, chunk_end) is fully accumulated, writes it to
+  // "digest" and returns true.  The chunk's stream is discarded either way.
+  bool Finish(uint64_t chunk_start, uint64_t chunk_end, byte* digest);
+
+ private:
+  struct Stream {
+    explicit Stream(EncryptionAlgorithm version) : end(0), hash(MakeChunkHash(version)), digest() {}
+    uint64_t end;  // position up to which the chunk's bytes have been hashed
+    // null once the prefix is complete, when "digest" holds its hash instead
+    std::unique_ptr<ChunkHash> hash;
+    std::array<byte, 64> digest;
+  };
+  typedef std::map<uint64_t, Stream>::iterator StreamIterator;
+
+  StreamIterator Erase(StreamIterator itr);
+  // Discards the lowest live streams until at most kMaxLiveStreams_ remain
+  void LimitLiveStreams();
+
+  const EncryptionAlgorithm kVersion_;
+  const uint32_t kPrefixLength_;
+  const size_t kMaxLiveStreams_;
+  std::map<uint64_t, Stream> streams_;  // keyed by chunk start
+  size_t live_streams_;  // streams still holding a hashing state
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_PRE_HASH_TRACKER_H_
@@ -19,24 +19,15 @@
 #include "maidsafe/encrypt/self_encryptor.h"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <limits>
+#include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <memory>
 #include <functional>
-#include <future>
-
-#ifdef __MSVC__
-#pragma warning(push, 1)
-#endif
-#include "cryptopp/aes.h"
-#include "cryptopp/gzip.h"
-#include "cryptopp/modes.h"
-#include "cryptopp/mqueue.h"
-#include "cryptopp/sha.h"
-#ifdef __MSVC__
-#pragma warning(pop)
-#endif
 
 #include "boost/exception/all.hpp"
 
@@ -50,8 +41,16 @@
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/encrypt/buffer_pool.h"
+#include "maidsafe/encrypt/chunk_codec.h"
+#include "maidsafe/encrypt/chunk_hash.h"
+#include "maidsafe/encrypt/chunk_status_table.h"
 #include "maidsafe/encrypt/data_map_encryptor.h"
+#include "maidsafe/encrypt/pre_hash_tracker.h"
 #include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/sequencer.h"
+#include "maidsafe/encrypt/sha512_batch.h"
+#include "maidsafe/encrypt/thread_pool.h"
 #include "maidsafe/encrypt/xor.h"
 
 namespace maidsafe {
@@ -59,168 +58,369 @@ namespace maidsafe {
 namespace encrypt {
 
 SelfEncryptor::SelfEncryptor(DataMap& data_map, DataBuffer& buffer,
-                             std::function<NonEmptyString(const std::string&)> get_from_store)
+                             std::function<NonEmptyString(const std::string&)> get_from_store,
+                             MemoryUsage max_memory_usage,
+                             const boost::filesystem::path& spill_directory,
+                             const Executor& executor)
+    : SelfEncryptor(data_map, buffer, get_from_store, GetChunksFromStore(), max_memory_usage,
+                    spill_directory, executor) {}
+
+SelfEncryptor::SelfEncryptor(DataMap& data_map, DataBuffer& buffer,
+                             GetChunksFromStore get_chunks_from_store,
+                             MemoryUsage max_memory_usage,
+                             const boost::filesystem::path& spill_directory,
+                             const Executor& executor)
+    : SelfEncryptor(data_map, buffer, std::function<NonEmptyString(const std::string&)>(),
+                    get_chunks_from_store, max_memory_usage, spill_directory, executor) {}
+
+SelfEncryptor::SelfEncryptor(DataMap& data_map, DataBuffer& buffer,
+                             std::function<NonEmptyString(const std::string&)> get_from_store,
+                             GetChunksFromStore get_chunks_from_store,
+                             MemoryUsage max_memory_usage,
+                             const boost::filesystem::path& spill_directory,
+                             const Executor& executor)
     : data_map_(data_map),
       kOriginalDataMap_(data_map),
-      sequencer_(kMaxChunkSize * 3),  // space for  min first 3 chunks
-      chunks_(),
+      sequencer_(new Sequencer(spill_directory)),
+      buffer_pool_(DefaultBufferPool()),
+      chunks_(new ChunkStatusTable),
+      pre_hashes_(),
+      compression_policy_(std::make_shared<CompressionPolicy>()),
       buffer_(buffer),
       get_from_store_(get_from_store),
+      get_chunks_from_store_(get_chunks_from_store),
+      executor_(executor ? executor : DefaultExecutor()),
+      kMaxMemoryUsage_(max_memory_usage.data),
       file_size_(data_map.size()),
       closed_(false),
-      data_mutex_() {
-  if (!get_from_store) {
+      background_encryption_(false),
+      next_read_position_(0),
+      sequential_read_length_(0),
+      mutex_(),
+      data_mutex_(),
+      background_chunks_(),
+      loads_done_(),
+      background_(new TaskGroup(executor_, Concurrency())) {
+  if (!get_from_store_ && !get_chunks_from_store_) {
     LOG(kError) << "Need to have a non-null get_from_store functor.";
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
   }
-  auto pos(0);
+  if (!IsSelfEncryptionVersion(data_map_.self_encryption_version) ||
+      !SupportsCompression(data_map_.self_encryption_version, data_map_.compression)) {
+    LOG(kError) << "Unsupported self-encryption version "
+                << static_cast<uint32_t>(data_map_.self_encryption_version) << " with compression "
+                << static_cast<uint32_t>(data_map_.compression);
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::invalid_encryption_version));
+  }
+  // a hashing state is a small fraction of a chunk, so allowing one per chunk's worth of the memory
+  // budget keeps the tracker well within it however large the file grows
+  pre_hashes_.reset(new PreHashTracker(PreHashLength(data_map_.self_encryption_version),
+                                       data_map_.self_encryption_version,
+                                       static_cast<size_t>(kMaxMemoryUsage_ / kMaxChunkSize)));
   if (!data_map_.chunks.empty()) {
     assert(data_map_.chunks.size() >= 3);
+    chunks_->Resize(static_cast<uint32_t>(data_map_.chunks.size()));
     for (uint32_t i(0); i < data_map_.chunks.size(); ++i)
-      chunks_.insert(std::make_pair(i, ChunkStatus::remote));
-    for (uint32_t i(0); i < data_map_.chunks.size(); ++i) {
-      if (i < 3) {  // just populate first three chunks
-        ByteVector temp(DecryptChunk(i));
-        for (const auto& t : temp)
-          sequencer_[pos++] = t;
-      }
-    }
+      chunks_->Set(i, ChunkStatus::remote);
+    LoadChunks(std::vector<uint32_t>{0, 1, 2});  // just populate first three chunks
+    for (uint32_t i(0); i < 3; ++i)
+      chunks_->Set(i, ChunkStatus::stored);
   } else if (data_map_.content.size() > 0) {
-    for (const auto& t : data_map_.content)
-      sequencer_[pos++] = t;
-    chunks_.insert(std::make_pair(0, ChunkStatus::stored));
+    sequencer_->Write(data_map_.content.data(), static_cast<uint32_t>(data_map_.content.size()),
+                      0);
   }
 }
 
 SelfEncryptor::~SelfEncryptor() { assert(closed_ && "file not closed"); }
 
 bool SelfEncryptor::Write(const char* data, uint32_t length, uint64_t position) {
+  const ConstSpan span = {data, length};
+  return WriteV(&span, 1, position);
+}
+
+bool SelfEncryptor::Read(char* data, uint32_t length, uint64_t position) {
+  const MutableSpan span = {data, length};
+  return ReadV(&span, 1, position);
+}
+
+bool SelfEncryptor::WriteV(const ConstSpan* spans, size_t count, uint64_t position) {
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
   if (closed_)
     BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
   on_scope_exit ose([this] { CleanUpAfterException(); });
   SCOPED_PROFILE
 
-  file_size_ = std::max(file_size_, length + position);
-  PrepareWindow(length, position, true);
-  for (uint32_t i(0); i < length; ++i)
-    sequencer_[position + i] = data[i];  // direct as may be overwrite
+  uint64_t length(0);
+  for (size_t i(0); i != count; ++i)
+    length += spans[i].length;
+  if (length + position > file_size_)
+    Resize(length + position);
+  // work through a chunk at a time so memory can be released as we go
+  const uint64_t first_position(position);
+  uint64_t prepared_end(position);
+  for (size_t i(0); i != count; ++i) {
+    const byte* data(reinterpret_cast<const byte*>(spans[i].data));
+    uint32_t remaining(spans[i].length);
+    while (remaining != 0) {
+      if (position == prepared_end) {
+        uint32_t window(static_cast<uint32_t>(std::min<uint64_t>(
+            length, kMaxChunkSize - static_cast<uint32_t>(position % kMaxChunkSize))));
+        PrepareWindow(window, position, true);
+        prepared_end += window;
+        length -= window;
+      }
+      uint32_t piece(
+          static_cast<uint32_t>(std::min<uint64_t>(remaining, prepared_end - position)));
+      sequencer_->Write(data, piece, position);
+      TrackPreHashes(data, piece, position);
+      data += piece;
+      remaining -= piece;
+      position += piece;
+    }
+  }
+  // the chunks this write has moved past are taken to be finished with
+  if (background_encryption_ && position != first_position) {
+    EncryptInBackground(std::max(GetChunkNumber(first_position), 2U) - 2,
+                        GetChunkNumber(position - 1));
+  }
   ose.Release();
   return true;
 }
 
-bool SelfEncryptor::Read(char* data, uint32_t length, uint64_t position) {
+bool SelfEncryptor::ReadV(const MutableSpan* spans, size_t count, uint64_t position) {
+  uint64_t length(0);
+  for (size_t i(0); i != count; ++i)
+    length += spans[i].length;
+  uint32_t read_ahead(0);
+  {
+    // if everything is already in memory, concurrent reads needn't block each other
+    boost::shared_lock<boost::shared_mutex> shared_lock(mutex_);
+    if (closed_)
+      BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
+    if ((position + length) > file_size_)
+      return false;
+    read_ahead = ReadAheadChunks(position, length);
+    if (IsResident(position, length)) {
+      for (size_t i(0); i != count; ++i) {
+        sequencer_->Read(reinterpret_cast<byte*>(spans[i].data), spans[i].length, position);
+        position += spans[i].length;
+      }
+      if (!NeedsReadAhead(position, read_ahead))
+        return true;
+      length = 0;
+    }
+  }
+
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
   if (closed_)
     BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
   if ((position + length) > file_size_)
-    return false;  // This is unclear whether to allow the read and fill any unwritten parts with
-                   // zero if reading past EOF. Seems if a file is writtem past EOF then this shoudl
-                   // be OK, this object follows the pattern that a write past EOF is fine, any read
-                   // within that file will work, even on sparse files
+    return length == 0;  // This is unclear whether to allow the read and fill any unwritten parts
+                         // with zero if reading past EOF. Seems if a file is writtem past EOF then
+                         // this shoudl be OK, this object follows the pattern that a write past EOF
+                         // is fine, any read within that file will work, even on sparse files
   on_scope_exit ose([this] { CleanUpAfterException(); });
   SCOPED_PROFILE
-  PrepareWindow(length, position, false);
-  for (uint32_t i(0); i < length; ++i)
-    data[i] = sequencer_[position + i];
+  uint64_t prepared_end(position);
+  for (size_t i(0); length != 0 && i != count; ++i) {
+    byte* data(reinterpret_cast<byte*>(spans[i].data));
+    uint32_t remaining(spans[i].length);
+    while (remaining != 0) {
+      if (position == prepared_end) {
+        uint32_t window(static_cast<uint32_t>(std::min<uint64_t>(
+            length, kMaxChunkSize - static_cast<uint32_t>(position % kMaxChunkSize))));
+        PrepareWindow(window, position, false);
+        prepared_end += window;
+        length -= window;
+      }
+      uint32_t piece(
+          static_cast<uint32_t>(std::min<uint64_t>(remaining, prepared_end - position)));
+      sequencer_->Read(data, piece, position);
+      data += piece;
+      remaining -= piece;
+      position += piece;
+    }
+  }
+  if (read_ahead != 0 && position != 0)
+    ReadAhead(GetChunkNumber(position - 1) + 1, read_ahead);
   ose.Release();
   return true;
 }
 
 bool SelfEncryptor::Truncate(uint64_t position) {
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
   if (closed_)
     BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
   on_scope_exit ose([this] { CleanUpAfterException(); });
   SCOPED_PROFILE
 
-  auto old_size = file_size_;
-  file_size_ = position;  //  All helper methods calculate from file size
-  if (position < old_size) {
-    auto it(std::begin(chunks_));
-    while (it != std::end(chunks_))
-      if (it->first > position)
-        it = chunks_.erase(it);
-      else
-        ++it;
-  } else {
-    assert(position - old_size < std::numeric_limits<size_t>::max());
-    PrepareWindow(static_cast<uint32_t>(position - old_size), old_size, true);
-  }
+  Resize(position);
   ose.Release();
   return true;
 }
 
 bool SelfEncryptor::Flush() {
+  boost::shared_lock<boost::shared_mutex> lock(mutex_);
   if (closed_)
     BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
   return true;
 }  // noop until we can tell if this is required when asked
 
+void SelfEncryptor::SetCompressionPolicy(std::shared_ptr<CompressionPolicy> policy) {
+  if (!policy) {
+    LOG(kError) << "Need to have a non-null compression policy.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
+  if (closed_)
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
+  // background encryption reads compression_policy_
+  WaitForBackground();
+  compression_policy_ = std::move(policy);
+}
+
+void SelfEncryptor::SetBackgroundEncryption(bool enable) {
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
+  if (closed_)
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::encryptor_closed));
+  if (!enable)
+    WaitForBackground();
+  background_encryption_ = enable;
+}
+
 void SelfEncryptor::Close() {
+  std::lock_guard<boost::shared_mutex> lock(mutex_);
   if (closed_)
     return;  // can call close multiple times, safely
   on_scope_exit ose([this] { CleanUpAfterException(); });
   SCOPED_PROFILE
 
+  WaitForBackground();
   if (file_size_ < (3 * kMinChunkSize)) {
-    data_map_.content.clear();
-    data_map_.content.reserve(file_size_);
-    std::copy_n(std::begin(sequencer_), file_size_, std::back_inserter(data_map_.content));
+    data_map_.chunks.clear();
+    data_map_.content.resize(static_cast<size_t>(file_size_));
+    sequencer_->Read(data_map_.content.data(), static_cast<uint32_t>(file_size_), 0);
     ose.Release();
     closed_ = true;
     return;
   }
   assert(GetNumChunks() > 2 && "Try to close with less than 3 chunks");
-  data_map_.chunks.resize(GetNumChunks());
-  std::vector<std::future<void>> fut;
-  for (auto& chunk : chunks_) {
-    if (chunk.second == ChunkStatus::to_be_hashed ||
-        data_map_.chunks[chunk.first].pre_hash.empty() || GetNumChunks() == 3) {
-      auto this_size(GetChunkSize(chunk.first));
-      auto pos = GetStartEndPositions(chunk.first);
-
-      fut.emplace_back(std::async([=]() {
-        ByteVector tmp(this_size);
-        for (uint32_t i(0); i < this_size; ++i)
-          tmp[i] = sequencer_[i + pos.first];
-        assert(tmp.size() == this_size && "vector diff size from chunk size");
-        {
-          std::lock_guard<std::mutex> guard(data_mutex_);
-          data_map_.chunks[chunk.first].pre_hash.clear();
-          data_map_.chunks[chunk.first].pre_hash.resize(crypto::SHA512::DIGESTSIZE);
-        }
-        ByteVector tmp2(crypto::SHA512::DIGESTSIZE);
-        CryptoPP::SHA512().CalculateDigest(&tmp2.data()[0], &tmp.data()[0],
-                                           crypto::SHA512::DIGESTSIZE);
-        {
-          std::lock_guard<std::mutex> guard(data_mutex_);
-          std::swap(data_map_.chunks[chunk.first].pre_hash, tmp2);
-          assert(crypto::SHA512::DIGESTSIZE == data_map_.chunks[chunk.first].pre_hash.size() &&
-                 "Hash size wrong");
-        }
-      }));
-      chunk.second = ChunkStatus::to_be_encrypted;
+  auto num_chunks(GetNumChunks());
+  data_map_.chunks.resize(num_chunks);
+  std::vector<uint32_t> to_hash, to_encrypt;
+  for (uint32_t chunk_num(0); chunk_num != chunks_->size(); ++chunk_num) {
+    auto status(chunks_->Get(chunk_num));
+    if (status == ChunkStatus::unused)
+      continue;
+    if (status == ChunkStatus::to_be_hashed || data_map_.chunks[chunk_num].pre_hash.empty() ||
+        num_chunks == 3) {
+      to_hash.push_back(chunk_num);
+      status = ChunkStatus::to_be_encrypted;
     }
+    if (status == ChunkStatus::to_be_encrypted)
+      to_encrypt.push_back(chunk_num);
   }
-  // thread barrier emulation
-  for (auto& res : fut)
-    res.wait();
-  std::vector<std::future<void>> fut2;
-  for (auto& chunk : chunks_) {
-    if (chunk.second == ChunkStatus::to_be_encrypted) {
-      auto this_size(GetChunkSize(chunk.first));
-      auto pos = GetStartEndPositions(chunk.first);
-
-      fut2.emplace_back(std::async([=]() {
-        ByteVector tmp(this_size);
-        for (uint32_t i(0); i < this_size; ++i)
-          tmp[i] = sequencer_[i + pos.first];
-        EncryptChunk(chunk.first, tmp, this_size);
-      }));
-      chunk.second = ChunkStatus::stored;
+
+  // Pre-hashes accumulated during writes are ready straight away.  If the rest only cover the start
+  // of each chunk they're cheap, so are also all calculated up front.  Otherwise each of these
+  // chunks is read back and hashed in full, so rather than wait for them all, chunk n is encrypted
+  // as soon as the pre-hashes of chunks n, n-1 and n-2 are ready.
+  const EncryptionAlgorithm version(data_map_.self_encryption_version);
+  std::vector<uint32_t> untracked(TakeTrackedPreHashes(to_hash));
+  if (PreHashLength(version) <= crypto::SHA512::DIGESTSIZE) {
+    HashChunks(untracked);
+    untracked.clear();
+  }
+  for (auto chunk_num : to_hash)
+    chunks_->Set(chunk_num, ChunkStatus::to_be_encrypted);
+
+  // count how many of the pre-hashes each chunk depends on are still outstanding
+  std::map<uint32_t, int> pending_hashes;
+  std::vector<uint32_t> ready;
+  for (auto chunk_num : to_encrypt) {
+    uint32_t n_1_chunk(GetPreviousChunkNumber(chunk_num));
+    int count(0);
+    for (auto dependency : {chunk_num, n_1_chunk, GetPreviousChunkNumber(n_1_chunk)}) {
+      if (std::binary_search(std::begin(untracked), std::end(untracked), dependency))
+        ++count;
     }
+    if (count == 0)
+      ready.push_back(chunk_num);
+    else
+      pending_hashes.insert({chunk_num, count});
+  }
+
+  // all chunks which are holes following two chunks with the same pre-hash encrypt identically,
+  // so only the first of these is actually encrypted
+  std::mutex pending_mutex;
+  std::vector<uint32_t> zero_chunks, unique_chunks;
+  auto is_duplicate([&](uint32_t chunk_num) {
+    if (!IsZeroChunk(chunk_num))
+      return false;
+    std::lock_guard<std::mutex> guard(pending_mutex);
+    zero_chunks.push_back(chunk_num);
+    if (zero_chunks.size() == 1)
+      return false;
+    chunks_->Set(chunk_num, ChunkStatus::stored);
+    return true;
+  });
+  for (auto chunk_num : ready) {
+    if (!is_duplicate(chunk_num))
+      unique_chunks.push_back(chunk_num);
   }
-  // thread barrier emulation
-  for (auto& res : fut2)
-    res.wait();
+
+  // Each task encrypts a group of the ready chunks so that their contents can be hashed in parallel
+  // SIMD lanes, but the groups are kept small enough for every thread to have one
+  auto concurrency(static_cast<size_t>(Concurrency()));
+  size_t group_size(std::max<size_t>(
+      1, std::min(ChunkHashBatchSize(version),
+                  (unique_chunks.size() + concurrency - 1) / concurrency)));
+  // now that the pre-hashes are final, every key is derived once up front, so the tasks read this
+  // table rather than the pre-hashes of three chunks from data_map_ apiece
+  std::vector<ChunkKeys> keys(unique_chunks.size());
+  for (size_t i(0); i != unique_chunks.size(); ++i)
+    GetPadIvKey(unique_chunks[i], keys[i]);
+  TaskGroup tasks(executor_, Concurrency());
+  // the outstanding pre-hashes are queued first, since their chunks can't start until they finish
+  size_t hash_group_size(ChunkHashBatchSize(version));
+  for (size_t i(0); i < untracked.size(); i += hash_group_size) {
+    tasks.Run([&, i] {
+      size_t end(std::min(i + hash_group_size, untracked.size()));
+      HashChunkGroup(&untracked[i], end - i);
+      std::vector<uint32_t> now_ready;
+      {
+        std::lock_guard<std::mutex> guard(pending_mutex);
+        for (size_t j(i); j != end; ++j) {
+          uint32_t n1_chunk(GetNextChunkNumber(untracked[j]));
+          for (auto dependent : {untracked[j], n1_chunk, GetNextChunkNumber(n1_chunk)}) {
+            auto itr(pending_hashes.find(dependent));
+            if (itr != std::end(pending_hashes) && --itr->second == 0)
+              now_ready.push_back(dependent);
+          }
+        }
+      }
+      // encrypted here rather than queued, while the chunk just hashed is likely still in cache
+      for (auto chunk_num : now_ready) {
+        if (!is_duplicate(chunk_num))
+          EncryptChunk(chunk_num, GetChunkData(chunk_num), GetChunkSize(chunk_num));
+        chunks_->Set(chunk_num, ChunkStatus::stored);
+      }
+    });
+  }
+  for (size_t i(0); i < unique_chunks.size(); i += group_size) {
+    std::vector<uint32_t> group(
+        std::begin(unique_chunks) + i,
+        std::begin(unique_chunks) + std::min(i + group_size, unique_chunks.size()));
+    const ChunkKeys* group_keys(keys.data() + i);
+    tasks.Run([this, group, group_keys] {
+      EncryptChunks(group, group_keys);
+      for (auto chunk_num : group)
+        chunks_->Set(chunk_num, ChunkStatus::stored);
+    });
+  }
+  tasks.Wait();
+  for (auto chunk_num : zero_chunks)
+    data_map_.chunks[chunk_num] = data_map_.chunks[zero_chunks.front()];
   ose.Release();
   closed_ = true;
 }
@@ -228,196 +428,561 @@ void SelfEncryptor::Close() {
 // ##############################Private######################
 
 void SelfEncryptor::PrepareWindow(uint32_t length, uint64_t position, bool write) {
-  if (sequencer_.size() < file_size_) {
-    sequencer_.resize(file_size_);
-    assert(sequencer_.size() == file_size_);
-  }
   if (file_size_ < (3 * kMinChunkSize))
     return;
-  auto first_chunk(GetChunkNumber(position));
-  auto last_chunk(GetChunkNumber(position + length));
-  if (write && (sequencer_.size() < (position + length))) {
-    sequencer_.resize(position + length);
-    assert(sequencer_.size() == (position + length) && "could not resize sequencer");
+  auto num_chunks(GetNumChunks());
+  uint32_t first_chunk(0), last_chunk(num_chunks), window_end(num_chunks);
+  if (file_size_ >= 3 * kMaxChunkSize) {  // otherwise encrypt all
+    first_chunk = std::min(GetChunkNumber(position), num_chunks - 1);
+    // chunks n+1 and n+2 are keyed from the pre-hash of chunk n, so are needed when writing.  Any
+    // reading ahead is done separately.
+    last_chunk = GetChunkNumber(position + std::max(length, 1U) - 1) + (write ? 3 : 1);
+    window_end = std::min(last_chunk, num_chunks);
   }
-  if (file_size_ < 3 * kMaxChunkSize) {
-    first_chunk = 0;  // in this case encrypt all.
-    last_chunk = 3;
-    chunks_.clear();  // make sure to mark all correctly
-  } else {            // do not read ahead unless possible
-    for (auto i(1); i < 3; ++i)
-      if (last_chunk < GetNumChunks())
-        ++last_chunk;
-  }
-
-  std::vector<std::future<void>> fut2;
-  for (auto i(first_chunk); i < last_chunk; ++i) {
-    auto current_chunk_itr = chunks_.find(i);
-    if (current_chunk_itr == std::end(chunks_)) {
-      write ? chunks_.insert({i, ChunkStatus::to_be_hashed}) :
-              chunks_.insert({i, ChunkStatus::stored});
-    } else {
-      auto pos(GetStartEndPositions(i).first);
-      if (current_chunk_itr->second == ChunkStatus::remote) {
-        fut2.emplace_back(std::async([=]() {
-          auto ins = pos;
-          ByteVector tmp(DecryptChunk(i));
-          for (const auto& t : tmp)
-            sequencer_[ins++] = t;
-        }));
-        write ? current_chunk_itr->second = ChunkStatus::to_be_hashed : current_chunk_itr->second =
-                                                                            ChunkStatus::stored;
-      } else {
-        current_chunk_itr->second = ChunkStatus::to_be_hashed;
+
+  // chunks being encrypted in the background mustn't change under the tasks, and those being read
+  // ahead aren't yet usable
+  if (write && InBackground(first_chunk, window_end))
+    WaitForBackground();
+  else if (!write)
+    WaitForLoads(first_chunk, window_end);
+
+  std::vector<uint32_t> to_load;
+  auto mark([&](uint32_t chunk_num) {
+    auto status(chunks_->Get(chunk_num));
+    if (status == ChunkStatus::remote)
+      to_load.push_back(chunk_num);
+    if (write)
+      chunks_->Set(chunk_num, ChunkStatus::to_be_hashed);
+    else if (status == ChunkStatus::unused || status == ChunkStatus::remote)
+      chunks_->Set(chunk_num, ChunkStatus::stored);
+  });
+  for (auto i(first_chunk); i < window_end; ++i)
+    mark(i);
+  // dependents of the last chunks wrap round to chunks 0 and 1
+  for (auto i(num_chunks); write && i < last_chunk && i < num_chunks + 2; ++i)
+    mark(i - num_chunks);
+
+  LoadChunks(to_load);
+  // when writing, leave room for the pages the data is about to be copied into
+  ReleaseMemory(first_chunk, window_end, write ? kMaxChunkSize : 0);
+}
+
+void SelfEncryptor::Resize(uint64_t new_size) {
+  if (new_size == file_size_)
+    return;
+  // Only the chunks before the last two of both the old and the new layout keep their boundaries
+  uint32_t first_moved_chunk(0);
+  if (file_size_ >= 3 * kMaxChunkSize && new_size >= 3 * kMaxChunkSize) {
+    uint64_t smaller(std::min<uint64_t>(file_size_, new_size));
+    first_moved_chunk = static_cast<uint32_t>(smaller / kMaxChunkSize) - 2 +
+                        (smaller % kMaxChunkSize == 0 ? 0 : 1);
+  }
+  if (InBackground(first_moved_chunk, std::numeric_limits<uint32_t>::max()))
+    WaitForBackground();
+
+  if (file_size_ >= 3 * kMinChunkSize) {
+    // read in, using the current layout, all moving chunks plus chunks 0 and 1 which are keyed
+    // from the last two
+    std::vector<uint32_t> to_load;
+    for (uint32_t chunk_num(0); chunk_num != chunks_->size(); ++chunk_num) {
+      if (chunks_->Get(chunk_num) == ChunkStatus::remote &&
+          (chunk_num < 2 || (chunk_num >= first_moved_chunk &&
+                             GetStartEndPositions(chunk_num).first < new_size))) {
+        to_load.push_back(chunk_num);
       }
     }
+    LoadChunks(to_load);
+  }
+
+  if (new_size < file_size_) {
+    sequencer_->Truncate(new_size);
+    pre_hashes_->Truncate(new_size);
+  }
+  file_size_ = new_size;
+  if (file_size_ < 3 * kMinChunkSize) {
+    chunks_->Resize(0);
+    return;
   }
-  // thread barrier emulation
-  for (auto& res : fut2)
-    res.wait();
+
+  auto num_chunks(GetNumChunks());
+  // background tasks may be updating the table, so must finish before it's reallocated
+  if (!chunks_->Fits(num_chunks))
+    WaitForBackground();
+  chunks_->Resize(num_chunks);
+  for (auto i(first_moved_chunk); i < num_chunks; ++i)
+    chunks_->Set(i, ChunkStatus::to_be_hashed);
+  chunks_->Set(0, ChunkStatus::to_be_hashed);
+  chunks_->Set(1, ChunkStatus::to_be_hashed);
 }
 
-ByteVector SelfEncryptor::DecryptChunk(uint32_t chunk_num) {
-  SCOPED_PROFILE
-  if (data_map_.chunks.size() < chunk_num) {
-    LOG(kWarning) << "Can't decrypt chunk " << chunk_num << " of " << data_map_.chunks.size();
-    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::failed_to_decrypt));
+void SelfEncryptor::LoadChunks(const std::vector<uint32_t>& chunk_nums) {
+  if (chunk_nums.empty())
+    return;
+  TaskGroup tasks(executor_, Concurrency());
+  StartLoading(chunk_nums, tasks, false);
+  tasks.Wait();
+}
+
+void SelfEncryptor::StartLoading(const std::vector<uint32_t>& chunk_nums, TaskGroup& tasks,
+                                 bool speculative) {
+  // the chunk numbers and their positions, shared by the tasks as these may outlive this call
+  auto targets(std::make_shared<std::vector<std::pair<uint32_t, uint64_t>>>());
+  for (auto chunk_num : chunk_nums)
+    targets->emplace_back(chunk_num, GetStartEndPositions(chunk_num).first);
+  auto finished([this, speculative](uint32_t chunk_num, std::exception_ptr error) {
+    if (!speculative) {
+      if (error)
+        std::rethrow_exception(error);
+      return;
+    }
+    if (error) {
+      // the chunk will be reloaded when actually needed
+      LOG(kWarning) << "Failed to read ahead chunk " << chunk_num;
+    }
+    chunks_->Set(chunk_num, error ? ChunkStatus::remote : ChunkStatus::stored);
+    std::lock_guard<std::mutex> guard(data_mutex_);
+    loads_done_.notify_all();
+  });
+  auto decrypt([this, finished](uint32_t chunk_num, uint64_t pos, const NonEmptyString& content) {
+    std::exception_ptr error;
+    try {
+      Buffer tmp(DecryptChunk(chunk_num, content));
+      sequencer_->Write(tmp.data(), static_cast<uint32_t>(tmp.size()), pos);
+      buffer_pool_.Return(std::move(tmp));
+    } catch (const std::exception&) {
+      error = std::current_exception();
+    }
+    finished(chunk_num, error);
+  });
+
+  if (!get_chunks_from_store_) {
+    for (const auto& target : *targets) {
+      auto chunk_num(target.first);
+      auto pos(target.second);
+      tasks.Run([=]() {
+        NonEmptyString content;
+        try {
+          content = FetchChunk(chunk_num);
+        } catch (const std::exception&) {
+          return finished(chunk_num, std::current_exception());
+        }
+        decrypt(chunk_num, pos, content);
+      });
+    }
+    return;
   }
 
-  uint32_t length = data_map_.chunks[chunk_num].size;
-  ByteVector data(length);
-  ByteVector pad(kPadSize);
-  ByteVector key(crypto::AES256_KeySize);
-  ByteVector iv(crypto::AES256_IVSize);
-  GetPadIvKey(chunk_num, key, iv, pad);
-  assert(pad.size() == kPadSize && "pad size incorrect");
-  assert(key.size() == crypto::AES256_KeySize && "key size incorrect");
-  assert(iv.size() == crypto::AES256_IVSize && "iv size incorrect");
-  NonEmptyString content;
+  // request the whole batch at once, and decrypt each chunk as it arrives
+  std::vector<std::string> names;
+  for (auto chunk_num : chunk_nums) {
+    names.emplace_back(std::begin(data_map_.chunks[chunk_num].hash),
+                       std::end(data_map_.chunks[chunk_num].hash));
+  }
+  tasks.AddPending(static_cast<unsigned>(chunk_nums.size()));
+  TaskGroup* group(&tasks);
+  get_chunks_from_store_(names, [=](size_t index, std::exception_ptr error,
+                                    NonEmptyString content) {
+    auto chunk_num((*targets)[index].first);
+    if (error) {
+      group->Run([=] { finished(chunk_num, error); });
+    } else {
+      auto pos((*targets)[index].second);
+      auto shared_content(std::make_shared<NonEmptyString>(std::move(content)));
+      group->Run([=]() { decrypt(chunk_num, pos, *shared_content); });
+    }
+    group->RemovePending();
+  });
+}
+
+void SelfEncryptor::ReadAhead(uint32_t first_chunk, uint32_t count) {
+  if (file_size_ < 3 * kMaxChunkSize || count == 0)
+    return;
+  auto num_chunks(GetNumChunks());
+  auto end_chunk(static_cast<uint32_t>(std::min<uint64_t>(uint64_t(first_chunk) + count,
+                                                          num_chunks)));
+  std::vector<uint32_t> to_load;
+  for (auto i(first_chunk); i < end_chunk; ++i) {
+    if (chunks_->Get(i) == ChunkStatus::remote)
+      to_load.push_back(i);
+  }
+  if (to_load.empty())
+    return;
+  // keep the chunk currently being read too
+  ReleaseMemory(first_chunk - 1, end_chunk, to_load.size() * kMaxChunkSize);
+  for (auto chunk_num : to_load) {
+    chunks_->Set(chunk_num, ChunkStatus::loading);
+    background_chunks_.insert(chunk_num);
+  }
+  StartLoading(to_load, *background_, true);
+}
+
+uint32_t SelfEncryptor::ReadAheadChunks(uint64_t position, uint64_t length) {
+  // reading ahead grows with the length of the current sequential run, up to a quarter of the
+  // memory cap
+  uint64_t run_length(0);
+  if (next_read_position_.exchange(position + length) == position)
+    run_length = (sequential_read_length_ += length);
+  else
+    sequential_read_length_ = 0;
+  if (run_length == 0)
+    return 0;
+  uint64_t limit(std::min<uint64_t>(kMaxReadAheadChunks, kMaxMemoryUsage_ / (4 * kMaxChunkSize)));
+  return static_cast<uint32_t>(std::min<uint64_t>(limit, run_length / kMaxChunkSize + 1));
+}
+
+bool SelfEncryptor::NeedsReadAhead(uint64_t position, uint32_t count) const {
+  if (file_size_ < 3 * kMaxChunkSize || count == 0 || position == 0)
+    return false;
+  auto first_chunk(GetChunkNumber(position - 1) + 1);
+  auto end_chunk(static_cast<uint32_t>(std::min<uint64_t>(uint64_t(first_chunk) + count,
+                                                          GetNumChunks())));
+  for (auto i(first_chunk); i < end_chunk; ++i) {
+    if (chunks_->Get(i) == ChunkStatus::remote)
+      return true;
+  }
+  return false;
+}
+
+void SelfEncryptor::ReleaseMemory(uint32_t window_begin, uint32_t window_end, uint64_t reserve) {
+  // a spill file is already paged out by the OS as needed, so isn't worth encrypting chunks early
+  if (sequencer_->spilling())
+    return;
+  auto limit(kMaxMemoryUsage_ > reserve ? kMaxMemoryUsage_ - reserve : 0);
+  if (file_size_ < 3 * kMaxChunkSize || sequencer_->size() <= limit)
+    return;
+  auto num_chunks(GetNumChunks());
+  if (data_map_.chunks.size() < num_chunks) {
+    WaitForBackground();
+    data_map_.chunks.resize(num_chunks);
+  }
+
+  auto position(sequencer_->NextResidentPosition(GetStartEndPositions(2).first));
+  while (sequencer_->size() > limit &&
+         position != std::numeric_limits<uint64_t>::max()) {
+    auto chunk_num(GetChunkNumber(position));
+    if (chunk_num + 2 >= num_chunks)
+      return;
+    if (chunk_num >= window_begin && chunk_num < window_end) {
+      position = sequencer_->NextResidentPosition(GetStartEndPositions(window_end - 1).second);
+      continue;
+    }
+    if (InBackground(chunk_num, chunk_num + 1))
+      WaitForBackground();
+    ReleaseChunk(chunk_num);
+    position = sequencer_->NextResidentPosition(GetStartEndPositions(chunk_num).second);
+  }
+}
+
+void SelfEncryptor::ReleaseChunk(uint32_t chunk_num) {
+  auto status(chunks_->Use(chunk_num, ChunkStatus::to_be_hashed));
+  if (status == ChunkStatus::remote)
+    return;
+  if (status != ChunkStatus::stored || data_map_.chunks[chunk_num].hash.empty()) {
+    HashWithPredecessors(chunk_num);
+    EncryptChunk(chunk_num, GetChunkData(chunk_num), GetChunkSize(chunk_num));
+  }
+  auto pos(GetStartEndPositions(chunk_num));
+  sequencer_->Erase(pos.first, pos.second);
+  chunks_->Set(chunk_num, ChunkStatus::remote);
+}
+
+void SelfEncryptor::HashWithPredecessors(uint32_t chunk_num) {
+  // the key, iv and pad come from the pre-hashes of chunks n-1 and n-2, so fix those first
+  uint32_t n_1_chunk(GetPreviousChunkNumber(chunk_num));
+  std::vector<uint32_t> to_hash;
+  for (auto previous : {GetPreviousChunkNumber(n_1_chunk), n_1_chunk, chunk_num}) {
+    if (chunks_->Use(previous, ChunkStatus::to_be_hashed) == ChunkStatus::to_be_hashed ||
+        data_map_.chunks[previous].pre_hash.empty()) {
+      to_hash.push_back(previous);
+    }
+  }
+  HashChunks(TakeTrackedPreHashes(to_hash));
+  for (auto previous : to_hash)
+    chunks_->Set(previous, ChunkStatus::to_be_encrypted);
+}
+
+void SelfEncryptor::EncryptInBackground(uint32_t first_chunk, uint32_t end_chunk) {
+  auto num_chunks(GetNumChunks());
+  // chunks 0 and 1 are keyed from the last two chunks, and those may yet move
+  if (num_chunks < 5)
+    return;
+  first_chunk = std::max(first_chunk, 2U);
+  end_chunk = std::min(end_chunk, num_chunks - 2);
+  if (first_chunk >= end_chunk)
+    return;
+  if (data_map_.chunks.size() < num_chunks) {
+    WaitForBackground();
+    data_map_.chunks.resize(num_chunks);
+  }
+  for (auto chunk_num(first_chunk); chunk_num < end_chunk; ++chunk_num) {
+    auto status(chunks_->Get(chunk_num));
+    if ((status != ChunkStatus::to_be_hashed && status != ChunkStatus::to_be_encrypted) ||
+        InBackground(chunk_num, chunk_num + 1))
+      continue;
+    // hashing is cheap when the pre-hash was accumulated as the chunk was written, or only covers
+    // the start of the chunk, so is done here rather than having each task depend on the two
+    // before it
+    HashWithPredecessors(chunk_num);
+    background_chunks_.insert(chunk_num);
+    auto pos(GetStartEndPositions(chunk_num));
+    auto length(static_cast<uint32_t>(pos.second - pos.first));
+    background_->Run([=] {
+      Buffer data(buffer_pool_.Get(length));
+      sequencer_->Read(data.data(), length, pos.first);
+      EncryptChunk(chunk_num, std::move(data), length);
+      chunks_->Set(chunk_num, ChunkStatus::stored);
+    });
+  }
+}
+
+void SelfEncryptor::WaitForBackground() {
+  if (background_chunks_.empty())
+    return;
+  background_chunks_.clear();
+  background_->Wait();
+}
+
+void SelfEncryptor::WaitForLoads(uint32_t first_chunk, uint32_t end_chunk) {
+  std::unique_lock<std::mutex> lock(data_mutex_);
+  for (auto i(first_chunk); i < end_chunk; ++i)
+    loads_done_.wait(lock, [&] { return chunks_->Get(i) != ChunkStatus::loading; });
+}
+
+bool SelfEncryptor::IsResident(uint64_t position, uint64_t length) const {
+  auto num_chunks(GetNumChunks());
+  if (num_chunks == 0 || length == 0)
+    return true;
+  auto last_chunk(std::min(GetChunkNumber(position + length - 1), num_chunks - 1));
+  for (auto i(GetChunkNumber(position)); i <= last_chunk; ++i) {
+    auto status(chunks_->Get(i));
+    if (status == ChunkStatus::unused || status == ChunkStatus::remote ||
+        status == ChunkStatus::loading)
+      return false;
+  }
+  return true;
+}
+
+bool SelfEncryptor::InBackground(uint32_t first_chunk, uint32_t end_chunk) const {
+  auto itr(background_chunks_.lower_bound(first_chunk));
+  return itr != std::end(background_chunks_) && *itr < end_chunk;
+}
+
+void SelfEncryptor::TrackPreHashes(const byte* data, uint32_t length, uint64_t position) {
+  if (file_size_ < 3 * kMinChunkSize)
+    return;
+  while (length != 0) {
+    auto pos(GetStartEndPositions(GetChunkNumber(position)));
+    auto piece(static_cast<uint32_t>(std::min<uint64_t>(length, pos.second - position)));
+    pre_hashes_->Write(data, piece, position, pos.first);
+    data += piece;
+    length -= piece;
+    position += piece;
+  }
+}
+
+std::vector<uint32_t> SelfEncryptor::TakeTrackedPreHashes(
+    const std::vector<uint32_t>& chunk_nums) {
+  std::array<byte, crypto::SHA512::DIGESTSIZE> pre_hash;
+  std::vector<uint32_t> untracked;
+  for (auto chunk_num : chunk_nums) {
+    auto pos(GetStartEndPositions(chunk_num));
+    if (!pre_hashes_->Finish(pos.first, pos.second, pre_hash.data())) {
+      untracked.push_back(chunk_num);
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(data_mutex_);
+    data_map_.chunks[chunk_num].pre_hash.assign(std::begin(pre_hash), std::end(pre_hash));
+  }
+  return untracked;
+}
+
+void SelfEncryptor::HashChunks(const std::vector<uint32_t>& chunk_nums) {
+  // hashed in groups sized to suit the version's hash, with the groups run in parallel
+  size_t group_size(ChunkHashBatchSize(data_map_.self_encryption_version));
+  if (chunk_nums.size() <= group_size) {
+    HashChunkGroup(chunk_nums.data(), chunk_nums.size());
+    return;
+  }
+  TaskGroup tasks(executor_, Concurrency());
+  for (size_t i(0); i < chunk_nums.size(); i += group_size) {
+    tasks.Run([&, i] {
+      HashChunkGroup(&chunk_nums[i], std::min(group_size, chunk_nums.size() - i));
+    });
+  }
+  tasks.Wait();
+}
+
+void SelfEncryptor::HashChunkGroup(const uint32_t* chunk_nums, size_t count) {
+  typedef std::array<byte, crypto::SHA512::DIGESTSIZE> Digest;
+  const EncryptionAlgorithm version(data_map_.self_encryption_version);
+  std::vector<Digest> pre_hashes(count);
+  std::vector<Buffer> data;
+  std::vector<HashJob> jobs;
+  data.reserve(count);
+  jobs.reserve(count);
+  for (size_t i(0); i != count; ++i) {
+    auto pos(GetStartEndPositions(chunk_nums[i]));
+    auto length(static_cast<uint32_t>(
+        std::min<uint64_t>(pos.second - pos.first, PreHashLength(version))));
+    data.push_back(buffer_pool_.Get(length));
+    sequencer_->Read(data.back().data(), length, pos.first);
+    jobs.push_back(HashJob{data.back().data(), length, pre_hashes[i].data()});
+  }
+  CalculateChunkHashes(version, jobs.data(), jobs.size());
+  for (auto& buffer : data)
+    buffer_pool_.Return(std::move(buffer));
+
+  std::lock_guard<std::mutex> guard(data_mutex_);
+  for (size_t i(0); i != count; ++i) {
+    data_map_.chunks[chunk_nums[i]].pre_hash.assign(std::begin(pre_hashes[i]),
+                                                    std::end(pre_hashes[i]));
+  }
+}
+
+bool SelfEncryptor::IsZeroChunk(uint32_t chunk_num) const {
+  if (GetChunkSize(chunk_num) != kMaxChunkSize)
+    return false;
+  auto pos(GetStartEndPositions(chunk_num));
+  if (!sequencer_->IsHole(pos.first, pos.second))
+    return false;
+  uint32_t n_1_chunk(GetPreviousChunkNumber(chunk_num));
+  uint32_t n_2_chunk(GetPreviousChunkNumber(n_1_chunk));
+  const ChunkDigest& pre_hash(data_map_.chunks[chunk_num].pre_hash);
+  return data_map_.chunks[n_1_chunk].pre_hash == pre_hash &&
+         data_map_.chunks[n_2_chunk].pre_hash == pre_hash;
+}
+
+Buffer SelfEncryptor::GetChunkData(uint32_t chunk_num) const {
+  auto pos(GetStartEndPositions(chunk_num));
+  Buffer data(buffer_pool_.Get(static_cast<size_t>(pos.second - pos.first)));
+  sequencer_->Read(data.data(), static_cast<uint32_t>(data.size()), pos.first);
+  return data;
+}
+
+NonEmptyString SelfEncryptor::FetchChunk(uint32_t chunk_num) const {
   try {
-    content = get_from_store_(std::string(std::begin(data_map_.chunks[chunk_num].hash),
-                                          std::end(data_map_.chunks[chunk_num].hash)));
+    return get_from_store_(std::string(std::begin(data_map_.chunks[chunk_num].hash),
+                                       std::end(data_map_.chunks[chunk_num].hash)));
   } catch (const std::exception& e) {
     LOG(kInfo) << boost::diagnostic_information(e);
     throw;
   }
-  // asserts on vector sizes
-  CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption decryptor(&key.data()[0], crypto::AES256_KeySize,
-                                                          &iv.data()[0]);
-  CryptoPP::ArraySource filter(
-      content.data(), content.size(), true,
-      new XORFilter(new CryptoPP::StreamTransformationFilter(
-                        decryptor, new CryptoPP::Gunzip(new CryptoPP::MessageQueue)),
-                    &pad.data()[0]));
-  filter.Get(&data.data()[0], length);
-  auto chunk_itr(chunks_.find(chunk_num));
-  assert(chunk_itr != std::end(chunks_) && "chunks status not found");
-  chunk_itr->second = ChunkStatus::stored;
+}
 
+Buffer SelfEncryptor::DecryptChunk(uint32_t chunk_num, const NonEmptyString& content) {
+  SCOPED_PROFILE
+  if (data_map_.chunks.size() < chunk_num) {
+    LOG(kWarning) << "Can't decrypt chunk " << chunk_num << " of " << data_map_.chunks.size();
+    BOOST_THROW_EXCEPTION(MakeError(EncryptErrors::failed_to_decrypt));
+  }
+
+  uint32_t length = data_map_.chunks[chunk_num].size;
+  Buffer data(buffer_pool_.Get(length));
+  ChunkKeys keys;
+  GetPadIvKey(chunk_num, keys);
+  DecodeChunk(reinterpret_cast<const byte*>(content.data()), content.size(),
+              data_map_.compression, data_map_.chunks[chunk_num].compressed, keys.key.data(),
+              keys.iv.data(), keys.pad.data(), data.data(), length);
   return data;
 }
 
-void SelfEncryptor::GetPadIvKey(uint32_t chunk_number, ByteVector& key, ByteVector& iv,
-                                ByteVector& pad) {
+void SelfEncryptor::GetPadIvKey(uint32_t chunk_number, ChunkKeys& keys) const {
   SCOPED_PROFILE
-  assert(pad.size() == kPadSize && "pad size incorrect");
-  assert(key.size() == crypto::AES256_KeySize && "key size incorrect");
-  assert(iv.size() == crypto::AES256_IVSize && "iv size incorrect");
+  byte* key(keys.key.data());
+  byte* iv(keys.iv.data());
+  byte* pad(keys.pad.data());
   uint32_t n_1_chunk(GetPreviousChunkNumber(chunk_number));
   uint32_t n_2_chunk(GetPreviousChunkNumber(n_1_chunk));
-#ifndef NDEBUG
-  auto chunk_n_1_itr(chunks_.find(n_1_chunk));
-  auto chunk_n_2_itr(chunks_.find(n_2_chunk));
-#endif
-  assert(chunks_.size() >= n_1_chunk);
-  assert(chunks_.size() >= n_2_chunk);
-  assert(chunk_n_1_itr != std::end(chunks_) && "chunk_n_1 chunkstatus not found");
-  assert(chunk_n_2_itr != std::end(chunks_) && "chunk_n_2 chunkstatus not found");
-
-  const ByteVector n_1_pre_hash{data_map_.chunks[n_1_chunk].pre_hash};
-  const ByteVector n_2_pre_hash{data_map_.chunks[n_2_chunk].pre_hash};
+  const ChunkDigest& n_1_pre_hash(data_map_.chunks[n_1_chunk].pre_hash);
+  const ChunkDigest& n_2_pre_hash(data_map_.chunks[n_2_chunk].pre_hash);
+  const ChunkDigest& this_pre_hash(data_map_.chunks[chunk_number].pre_hash);
 
   assert(n_1_pre_hash.size() == crypto::SHA512::DIGESTSIZE);
   assert(n_2_pre_hash.size() == crypto::SHA512::DIGESTSIZE);
-  key.clear();
+  assert(this_pre_hash.size() == crypto::SHA512::DIGESTSIZE);
   // cannot use copy_n as there is an apparent bug in MSVC 2013 :-(
-  std::copy(std::begin(n_2_pre_hash), std::begin(n_2_pre_hash) + crypto::AES256_KeySize,
-            std::back_inserter(key));
-  iv.clear();
+  std::copy(std::begin(n_2_pre_hash), std::begin(n_2_pre_hash) + crypto::AES256_KeySize, key);
   std::copy(std::begin(n_2_pre_hash) + crypto::AES256_KeySize,
-            std::begin(n_2_pre_hash) + crypto::AES256_KeySize + crypto::AES256_IVSize,
-            std::back_inserter(iv));
+            std::begin(n_2_pre_hash) + crypto::AES256_KeySize + crypto::AES256_IVSize, iv);
   // pad
   assert(kPadSize ==
              (2 * crypto::SHA512::DIGESTSIZE) + crypto::SHA512::DIGESTSIZE -
                  crypto::AES256_KeySize - crypto::AES256_IVSize &&
          "pad size wrong");
-  pad.clear();
-  std::copy_n(std::begin(n_1_pre_hash), crypto::SHA512::DIGESTSIZE, std::back_inserter(pad));
-  std::copy_n(std::begin(data_map_.chunks[chunk_number].pre_hash), crypto::SHA512::DIGESTSIZE,
-              std::back_inserter(pad));  // + crypto::SHA512::DIGESTSIZE);
-  std::copy_n(std::begin(n_2_pre_hash) + crypto::AES256_KeySize + crypto::AES256_IVSize,
-              crypto::SHA512::DIGESTSIZE - crypto::AES256_KeySize - crypto::AES256_IVSize,
-              std::back_inserter(pad));  // + crypto::SHA512::DIGESTSIZE * 2);
-  assert(pad.size() == kPadSize && "pad size incorrect");
-  assert(key.size() == crypto::AES256_KeySize && "key size incorrect");
-  assert(iv.size() == crypto::AES256_IVSize && "iv size incorrect");
-}
-
-void SelfEncryptor::EncryptChunk(uint32_t chunk_number, ByteVector data, uint32_t length) {
+  pad = std::copy(std::begin(n_1_pre_hash), std::end(n_1_pre_hash), pad);
+  pad = std::copy(std::begin(this_pre_hash), std::end(this_pre_hash), pad);
+  std::copy(std::begin(n_2_pre_hash) + crypto::AES256_KeySize + crypto::AES256_IVSize,
+            std::end(n_2_pre_hash), pad);
+}
+
+void SelfEncryptor::EncryptChunk(uint32_t chunk_number, Buffer data, uint32_t length) {
   SCOPED_PROFILE
-  auto chunk_n_itr(chunks_.find(chunk_number));
-  assert(chunk_n_itr != std::end(chunks_) && "this chunk chunkstatus not found");
-#ifndef NDEBUG
-  {
-    std::lock_guard<std::mutex> guard(data_mutex_);
-    assert(data_map_.chunks.size() >= chunk_number);
-    assert(chunks_.size() >= chunk_number);
-    uint32_t n_1_chunk(GetPreviousChunkNumber(chunk_number));
-    uint32_t n_2_chunk(GetPreviousChunkNumber(n_1_chunk));
-    auto chunk_n_1_itr(chunks_.find(n_1_chunk));
-    auto chunk_n_2_itr(chunks_.find(n_2_chunk));
-
-    assert(chunk_n_1_itr->second != ChunkStatus::to_be_hashed && "chunk_n_1 hash invalid");
-    assert(chunk_n_2_itr->second != ChunkStatus::to_be_hashed && "chunk_n_2 hash invalid");
-  }
-#endif
-
-  ByteVector pad(kPadSize);
-  ByteVector key(crypto::AES256_KeySize);
-  ByteVector iv(crypto::AES256_IVSize);
-  GetPadIvKey(chunk_number, key, iv, pad);
-  assert(pad.size() == kPadSize && "pad size incorrect");
-  assert(key.size() == crypto::AES256_KeySize && "key size incorrect");
-  assert(iv.size() == crypto::AES256_IVSize && "iv size incorrect");
-
-  CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption encryptor(&key.data()[0], crypto::AES256_KeySize,
-                                                          &iv.data()[0]);
-
-  std::string chunk_content;
-  chunk_content.reserve(length);
-  CryptoPP::Gzip aes_filter(
-      new CryptoPP::StreamTransformationFilter(
-          encryptor, new XORFilter(new CryptoPP::StringSink(chunk_content), &pad.data()[0])),
-      1);
-  aes_filter.Put2(&data.data()[0], length, -1, true);
-
-  CryptoPP::SHA512 hash;
-  std::string result;
-  CryptoPP::StringSource(chunk_content, true,
-                         new CryptoPP::HashFilter(hash, new CryptoPP::StringSink(result)));
-
-  buffer_.Store(DataBuffer::KeyType(Identity(result), DataTypeId(0)),
-                NonEmptyString(chunk_content));
+  ChunkKeys keys;
+  GetPadIvKey(chunk_number, keys);
+  EncodedChunk encoded(EncodeChunkData(chunk_number, std::move(data), length, keys));
+  std::array<byte, crypto::SHA512::DIGESTSIZE> result;
+  HashJob job = {reinterpret_cast<const byte*>(encoded.content.data()), encoded.content.size(),
+                 result.data()};
+  CalculateChunkHashes(data_map_.self_encryption_version, &job, 1);
+  StoreChunk(chunk_number, std::move(encoded), result.data(), length);
+}
+
+void SelfEncryptor::EncryptChunks(const std::vector<uint32_t>& chunk_nums, const ChunkKeys* keys) {
+  SCOPED_PROFILE
+  std::vector<EncodedChunk> contents;
+  contents.reserve(chunk_nums.size());
+  for (size_t i(0); i != chunk_nums.size(); ++i) {
+    contents.push_back(EncodeChunkData(chunk_nums[i], GetChunkData(chunk_nums[i]),
+                                       GetChunkSize(chunk_nums[i]), keys[i]));
+  }
+
+  std::vector<std::array<byte, crypto::SHA512::DIGESTSIZE>> names(chunk_nums.size());
+  std::vector<HashJob> jobs;
+  jobs.reserve(chunk_nums.size());
+  for (size_t i(0); i != chunk_nums.size(); ++i) {
+    jobs.push_back(HashJob{reinterpret_cast<const byte*>(contents[i].content.data()),
+                           contents[i].content.size(), names[i].data()});
+  }
+  CalculateChunkHashes(data_map_.self_encryption_version, jobs.data(), jobs.size());
+
+  for (size_t i(0); i != chunk_nums.size(); ++i) {
+    StoreChunk(chunk_nums[i], std::move(contents[i]), names[i].data(),
+               GetChunkSize(chunk_nums[i]));
+  }
+}
+
+EncodedChunk SelfEncryptor::EncodeChunkData(uint32_t chunk_number, Buffer data,
+                                            uint32_t length, const ChunkKeys& keys) {
+  // chunks_ isn't touched here as this may run in the background while it's being modified
+  assert(data_map_.chunks.size() > chunk_number);
+
+  int level(compression_policy_->Level());
+  auto start_time(std::chrono::steady_clock::now());
+  EncodedChunk encoded(EncodeChunk(data.data(), length, data_map_.self_encryption_version,
+                                   data_map_.compression, level, keys.key.data(), keys.iv.data(),
+                                   keys.pad.data()));
+  if (encoded.compressed && data_map_.compression == ChunkCompression::kGzip) {
+    compression_policy_->Record(level, length, encoded.content.size(),
+                                std::chrono::steady_clock::now() - start_time);
+  }
+  buffer_pool_.Return(std::move(data));
+  return encoded;
+}
+
+void SelfEncryptor::StoreChunk(uint32_t chunk_number, EncodedChunk encoded, const byte* name,
+                               uint32_t length) {
+  buffer_.Store(DataBuffer::KeyType(Identity(std::string(name, name + crypto::SHA512::DIGESTSIZE)),
+                                    DataTypeId(0)),
+                NonEmptyString(std::move(encoded.content)));
   {
     std::lock_guard<std::mutex> guard(data_mutex_);
-    ByteVector tmp2(std::begin(result), std::end(result));
-    std::swap(data_map_.chunks[chunk_number].hash, tmp2);
-    chunk_n_itr->second = ChunkStatus::stored;
+    data_map_.chunks[chunk_number].hash.assign(name, name + crypto::SHA512::DIGESTSIZE);
     assert(crypto::SHA512::DIGESTSIZE == data_map_.chunks[chunk_number].hash.size() &&
            "Hash size wrong");
 
     data_map_.chunks[chunk_number].size = length;  // keep pre-compressed length
+    data_map_.chunks[chunk_number].compressed = encoded.compressed;
     data_map_.chunks[chunk_number].storage_state = ChunkDetails::kPending;
   }
 }
@@ -473,17 +1038,18 @@ std::pair<uint64_t, uint64_t> SelfEncryptor::GetStartEndPositions(uint32_t chunk
   assert(GetNumChunks() > 2 && "less than 3 chunks");
   if (GetNumChunks() == 0)
     return {0, 0};
-  auto start(0);
+  uint64_t start(0);
   bool penultimate((GetNumChunks() - 2) == chunk_number);
   bool last((GetNumChunks() - 1) == chunk_number);
 
   if (last) {
-    start = ((GetChunkSize(0) * (chunk_number - 2)) + GetChunkSize(chunk_number - 2) +
-             GetChunkSize(chunk_number - 1));
+    start = ((static_cast<uint64_t>(GetChunkSize(0)) * (chunk_number - 2)) +
+             GetChunkSize(chunk_number - 2) + GetChunkSize(chunk_number - 1));
   } else if (penultimate) {
-    start = ((GetChunkSize(0) * (chunk_number - 1)) + GetChunkSize(chunk_number - 1));
+    start = ((static_cast<uint64_t>(GetChunkSize(0)) * (chunk_number - 1)) +
+             GetChunkSize(chunk_number - 1));
   } else {
-    start = (GetChunkSize(0) * (chunk_number));
+    start = (static_cast<uint64_t>(GetChunkSize(0)) * (chunk_number));
   }
 
   return std::make_pair(start, start + GetChunkSize(chunk_number));
@@ -502,11 +1068,18 @@ uint32_t SelfEncryptor::GetPreviousChunkNumber(uint32_t chunk_number) const {
 }
 
 uint32_t SelfEncryptor::GetChunkNumber(uint64_t position) const {
-  if (GetNumChunks() == 0) {
+  auto num_chunks(GetNumChunks());
+  if (num_chunks == 0) {
     return 0;
   }
 
-  return uint32_t(position / GetChunkSize(0));
+  auto chunk_num(uint32_t(position / GetChunkSize(0)));
+  // the penultimate chunk is shortened if the last would otherwise be under kMinChunkSize
+  if (file_size_ >= 3 * kMaxChunkSize && chunk_num + 2 == num_chunks &&
+      position >= GetStartEndPositions(chunk_num).second) {
+    ++chunk_num;
+  }
+  return chunk_num;
 }
 
 }  // namespace encrypt
@@ -0,0 +1,229 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/sequencer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "maidsafe/common/config.h"
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+// Size of each mapping of the spill file
+const uint64_t kSpillSegmentSize(64 * 1024 * 1024);
+
+bool IsZero(const byte* data, uint32_t length) {
+  return std::all_of(data, data + length, [](byte b) { return b == 0; });
+}
+
+}  // unnamed namespace
+
+Sequencer::Sequencer(const boost::filesystem::path& spill_directory)
+    : kPageSize_(4096),
+      pages_(),
+      spill_file_(),
+      spill_mapping_(),
+      spill_segments_(),
+      spill_segment_used_(kSpillSegmentSize),
+      free_pages_(),
+      mutex_() {
+  if (spill_directory.empty())
+    return;
+  try {
+    spill_file_ = spill_directory / boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.spill");
+    boost::filesystem::ofstream(spill_file_, std::ios::binary);
+    spill_mapping_.reset(new boost::interprocess::file_mapping(
+        spill_file_.string().c_str(), boost::interprocess::read_write));
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to create spill file in " << spill_directory << ": " << e.what();
+    boost::system::error_code ec;
+    boost::filesystem::remove(spill_file_, ec);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+}
+
+Sequencer::~Sequencer() {
+  if (!spill_mapping_) {
+    for (auto& page : pages_)
+      delete[] page.second;
+    return;
+  }
+  spill_segments_.clear();
+  spill_mapping_.reset();
+  boost::system::error_code ec;
+  boost::filesystem::remove(spill_file_, ec);
+  if (ec)
+    LOG(kWarning) << "Failed to remove spill file " << spill_file_ << ": " << ec.message();
+}
+
+void Sequencer::Write(const byte* data, uint32_t length, uint64_t position) {
+  std::lock_guard<boost::shared_mutex> guard(mutex_);
+  while (length != 0) {
+    uint64_t page_start(position - (position % kPageSize_));
+    uint32_t offset(static_cast<uint32_t>(position - page_start));
+    uint32_t count(std::min(length, kPageSize_ - offset));
+    auto itr(pages_.find(page_start));
+    if (itr != std::end(pages_)) {
+      std::memcpy(itr->second + offset, data, count);
+    } else if (!IsZero(data, count)) {
+      byte* page(AllocatePage());
+      std::memcpy(page + offset, data, count);
+      pages_.insert(std::make_pair(page_start, page));
+    }
+    data += count;
+    length -= count;
+    position += count;
+  }
+}
+
+void Sequencer::Read(byte* data, uint32_t length, uint64_t position) const {
+  boost::shared_lock<boost::shared_mutex> guard(mutex_);
+  while (length != 0) {
+    uint64_t page_start(position - (position % kPageSize_));
+    uint32_t offset(static_cast<uint32_t>(position - page_start));
+    uint32_t count(std::min(length, kPageSize_ - offset));
+    auto itr(pages_.find(page_start));
+    if (itr == std::end(pages_))
+      std::memset(data, 0, count);
+    else
+      std::memcpy(data, itr->second + offset, count);
+    data += count;
+    length -= count;
+    position += count;
+  }
+}
+
+void Sequencer::Erase(uint64_t begin, uint64_t end) {
+  std::lock_guard<boost::shared_mutex> guard(mutex_);
+  std::vector<byte*> freed;
+  auto itr(pages_.lower_bound(begin));
+  while (itr != std::end(pages_) && itr->first + kPageSize_ <= end) {
+    freed.push_back(itr->second);
+    itr = pages_.erase(itr);
+  }
+  FreePages(std::move(freed));
+}
+
+void Sequencer::Truncate(uint64_t position) {
+  std::lock_guard<boost::shared_mutex> guard(mutex_);
+  uint64_t page_start(position - (position % kPageSize_));
+  auto itr(pages_.lower_bound(page_start));
+  if (itr != std::end(pages_) && itr->first == page_start && position != page_start) {
+    std::fill(itr->second + (position - page_start), itr->second + kPageSize_, 0);
+    ++itr;
+  }
+  std::vector<byte*> freed;
+  while (itr != std::end(pages_)) {
+    freed.push_back(itr->second);
+    itr = pages_.erase(itr);
+  }
+  FreePages(std::move(freed));
+}
+
+uint64_t Sequencer::NextResidentPosition(uint64_t position) const {
+  boost::shared_lock<boost::shared_mutex> guard(mutex_);
+  auto itr(pages_.lower_bound(position - (position % kPageSize_)));
+  if (itr == std::end(pages_))
+    return std::numeric_limits<uint64_t>::max();
+  return std::max(itr->first, position);
+}
+
+bool Sequencer::IsHole(uint64_t begin, uint64_t end) const {
+  return NextResidentPosition(begin) >= end;
+}
+
+uint64_t Sequencer::size() const {
+  boost::shared_lock<boost::shared_mutex> guard(mutex_);
+  return static_cast<uint64_t>(pages_.size()) * kPageSize_;
+}
+
+byte* Sequencer::AllocatePage() {
+  if (!spill_mapping_)
+    return new byte[kPageSize_]();
+  if (!free_pages_.empty()) {
+    byte* page(free_pages_.back());
+    free_pages_.pop_back();
+#ifndef __linux__
+    std::memset(page, 0, kPageSize_);  // otherwise the page was released, so reads back as '\0's
+#endif
+    return page;
+  }
+  if (spill_segment_used_ == kSpillSegmentSize) {
+    // the file is grown sparsely, so unused parts of a segment take no disk space
+    uint64_t offset(spill_segments_.size() * kSpillSegmentSize);
+    try {
+      boost::filesystem::resize_file(spill_file_, offset + kSpillSegmentSize);
+      spill_segments_.emplace_back(new boost::interprocess::mapped_region(
+          *spill_mapping_, boost::interprocess::read_write, offset, kSpillSegmentSize));
+    } catch (const std::exception& e) {
+      LOG(kError) << "Failed to extend spill file " << spill_file_ << ": " << e.what();
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+    spill_segment_used_ = 0;
+  }
+  byte* page(static_cast<byte*>(spill_segments_.back()->get_address()) + spill_segment_used_);
+  spill_segment_used_ += kPageSize_;
+  return page;
+}
+
+void Sequencer::FreePages(std::vector<byte*> pages) {
+  if (!spill_mapping_) {
+    for (byte* page : pages)
+      delete[] page;
+    return;
+  }
+#ifdef __linux__
+  // punch a hole in the file behind each run of adjacent pages, which also drops them from the page
+  // cache.  The pages stay mapped and read back as '\0's, so can be reused as they are.
+  std::sort(std::begin(pages), std::end(pages));
+  for (size_t begin(0), end(1); begin != pages.size(); begin = end++) {
+    while (end != pages.size() && pages[end] == pages[end - 1] + kPageSize_)
+      ++end;
+    if (madvise(pages[begin], (end - begin) * kPageSize_, MADV_REMOVE) != 0) {
+      LOG(kWarning) << "Failed to release " << (end - begin) << " pages of spill file "
+                    << spill_file_;
+      for (size_t i(begin); i != end; ++i)
+        std::memset(pages[i], 0, kPageSize_);
+    }
+  }
+#endif
+  free_pages_.insert(std::end(free_pages_), std::begin(pages), std::end(pages));
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
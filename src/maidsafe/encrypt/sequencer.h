@@ -0,0 +1,97 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_SEQUENCER_H_
+#define MAIDSAFE_ENCRYPT_SEQUENCER_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/thread/shared_mutex.hpp"
+
+#include "maidsafe/encrypt/config.h"
+
+namespace boost {
+
+namespace interprocess {
+
+class file_mapping;
+class mapped_region;
+
+}  // namespace interprocess
+
+}  // namespace boost
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Holds the plaintext of a SelfEncryptor as a sparse table of fixed-size pages, so that only the
+// parts of the file which are actually resident occupy memory.  Ranges with no page (holes) read
+// back as '\0's, and writing '\0's into a hole does not allocate a page.
+//
+// If "spill_directory" is not empty, the pages are held in a temporary memory-mapped file created
+// there rather than on the heap, so that the OS can page out cold parts of very large files.  The
+// file space behind dropped pages is handed back to the OS where it supports this (Linux), so the
+// file and page cache shrink along with the data.
+class Sequencer {
+ public:
+  explicit Sequencer(const boost::filesystem::path& spill_directory = boost::filesystem::path());
+  ~Sequencer();
+  Sequencer(const Sequencer&) = delete;
+  Sequencer(Sequencer&&) = delete;
+  Sequencer& operator=(Sequencer) = delete;
+
+  void Write(const byte* data, uint32_t length, uint64_t position);
+  void Read(byte* data, uint32_t length, uint64_t position) const;
+  // Drops all pages lying wholly inside [begin, end)
+  void Erase(uint64_t begin, uint64_t end);
+  // Drops or zeroes all data at or beyond "position"
+  void Truncate(uint64_t position);
+  // Start of the first resident page at or after "position", or max uint64_t if there is none
+  uint64_t NextResidentPosition(uint64_t position) const;
+  // True if no part of [begin, end) is resident
+  bool IsHole(uint64_t begin, uint64_t end) const;
+  // Total bytes held in memory
+  uint64_t size() const;
+  // True if the pages are held in a spill file
+  bool spilling() const { return spill_mapping_ != nullptr; }
+
+ private:
+  byte* AllocatePage();
+  // Frees the pages, releasing the spill file space behind them
+  void FreePages(std::vector<byte*> pages);
+
+  const uint32_t kPageSize_;
+  std::map<uint64_t, byte*> pages_;
+  boost::filesystem::path spill_file_;
+  std::unique_ptr<boost::interprocess::file_mapping> spill_mapping_;
+  std::vector<std::unique_ptr<boost::interprocess::mapped_region>> spill_segments_;
+  uint64_t spill_segment_used_;
+  std::vector<byte*> free_pages_;
+  mutable boost::shared_mutex mutex_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_SEQUENCER_H_
@@ -0,0 +1,307 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/sha512_batch.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/sha.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+// The lane kernels are written once with GCC's generic vector types and instantiated for each
+// instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAIDSAFE_ENCRYPT_SHA512_LANES 1
+#endif
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+void HashPortable(const HashJob* jobs, size_t count) {
+  CryptoPP::SHA512 hash;
+  for (size_t i(0); i != count; ++i)
+    hash.CalculateDigest(jobs[i].digest, jobs[i].data, jobs[i].length);
+}
+
+#ifdef MAIDSAFE_ENCRYPT_SHA512_LANES
+
+const size_t kBlockSize(128);
+
+const uint64_t kInitialState[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+const uint64_t kRoundConstants[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL};
+
+typedef uint64_t Vector4 __attribute__((vector_size(32)));
+typedef uint64_t Vector8 __attribute__((vector_size(64)));
+
+#define MAIDSAFE_ENCRYPT_ALWAYS_INLINE inline __attribute__((always_inline))
+
+uint64_t LoadBigEndian(const byte* in) {
+  uint64_t word;
+  std::memcpy(&word, in, sizeof(word));
+  return __builtin_bswap64(word);
+}
+
+void StoreBigEndian(uint64_t word, byte* out) {
+  word = __builtin_bswap64(word);
+  std::memcpy(out, &word, sizeof(word));
+}
+
+// A message being worked through by one lane
+struct Lane {
+  const HashJob* job;
+  const byte* next_block;
+  size_t full_blocks;  // remaining before the padded tail
+  size_t tail_blocks;  // remaining of the padded tail
+  size_t tail_offset;  // of the next block of the padded tail
+  std::array<byte, 2 * kBlockSize> tail;
+};
+
+void StartLane(const HashJob& job, Lane& lane) {
+  lane.job = &job;
+  lane.next_block = job.data;
+  lane.full_blocks = job.length / kBlockSize;
+  // the final partial block, then 0x80, zeros, and the length in bits as a 128-bit number
+  size_t remainder(job.length % kBlockSize);
+  lane.tail.fill(0);
+  if (remainder != 0)
+    std::memcpy(lane.tail.data(), job.data + job.length - remainder, remainder);
+  lane.tail[remainder] = 0x80;
+  lane.tail_blocks = remainder + 1 + 16 <= kBlockSize ? 1 : 2;
+  lane.tail_offset = 0;
+  byte* end(lane.tail.data() + lane.tail_blocks * kBlockSize);
+  StoreBigEndian(static_cast<uint64_t>(job.length) >> 61, end - 16);
+  StoreBigEndian(static_cast<uint64_t>(job.length) << 3, end - 8);
+}
+
+const byte* CurrentBlock(const Lane& lane) {
+  if (lane.full_blocks != 0)
+    return lane.next_block;
+  return lane.tail.data() + lane.tail_offset;
+}
+
+// Returns true once the lane's message is finished
+bool AdvanceLane(Lane& lane) {
+  if (lane.full_blocks != 0) {
+    lane.next_block += kBlockSize;
+    --lane.full_blocks;
+    return false;
+  }
+  lane.tail_offset += kBlockSize;
+  return --lane.tail_blocks == 0;
+}
+
+// A macro rather than a function, as returning a vector from a function without the target's
+// instruction set enabled changes the ABI
+#define MAIDSAFE_ENCRYPT_ROTR(x, bits) (((x) >> (bits)) | ((x) << (64 - (bits))))
+
+// Runs the SHA-512 compression function on one block in each lane.  state[i][lane] is word i of the
+// lane's hash state.
+template <typename Vector, size_t kLanes>
+MAIDSAFE_ENCRYPT_ALWAYS_INLINE void CompressLanes(uint64_t (&state)[8][kLanes],
+                                                  const byte* const (&blocks)[kLanes]) {
+  Vector w[16];
+  for (size_t t(0); t != 16; ++t) {
+    for (size_t lane(0); lane != kLanes; ++lane)
+      w[t][lane] = LoadBigEndian(blocks[lane] + 8 * t);
+  }
+  Vector v[8];
+  for (size_t i(0); i != 8; ++i)
+    std::memcpy(&v[i], state[i], sizeof(Vector));
+  Vector a(v[0]), b(v[1]), c(v[2]), d(v[3]), e(v[4]), f(v[5]), g(v[6]), h(v[7]);
+  for (size_t t(0); t != 80; ++t) {
+    if (t >= 16) {
+      const Vector& w2(w[(t - 2) & 15]);
+      const Vector& w15(w[(t - 15) & 15]);
+      Vector s0(MAIDSAFE_ENCRYPT_ROTR(w15, 1) ^ MAIDSAFE_ENCRYPT_ROTR(w15, 8) ^ (w15 >> 7));
+      Vector s1(MAIDSAFE_ENCRYPT_ROTR(w2, 19) ^ MAIDSAFE_ENCRYPT_ROTR(w2, 61) ^ (w2 >> 6));
+      w[t & 15] += s0 + w[(t - 7) & 15] + s1;
+    }
+    Vector sum0(MAIDSAFE_ENCRYPT_ROTR(a, 28) ^ MAIDSAFE_ENCRYPT_ROTR(a, 34) ^
+                MAIDSAFE_ENCRYPT_ROTR(a, 39));
+    Vector sum1(MAIDSAFE_ENCRYPT_ROTR(e, 14) ^ MAIDSAFE_ENCRYPT_ROTR(e, 18) ^
+                MAIDSAFE_ENCRYPT_ROTR(e, 41));
+    Vector t1(h + sum1 + ((e & f) ^ (~e & g)) + kRoundConstants[t] + w[t & 15]);
+    Vector t2(sum0 + ((a & b) ^ (a & c) ^ (b & c)));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  v[0] += a;
+  v[1] += b;
+  v[2] += c;
+  v[3] += d;
+  v[4] += e;
+  v[5] += f;
+  v[6] += g;
+  v[7] += h;
+  for (size_t i(0); i != 8; ++i)
+    std::memcpy(state[i], &v[i], sizeof(Vector));
+}
+
+template <typename Vector, size_t kLanes>
+MAIDSAFE_ENCRYPT_ALWAYS_INLINE void HashLanes(const HashJob* jobs, size_t count) {
+  // idle lanes hash this, and their results are ignored
+  static const byte kIdleBlock[kBlockSize] = {};
+  uint64_t state[8][kLanes];
+  Lane lanes[kLanes];
+  bool active[kLanes];
+  size_t next_job(0), active_count(0);
+  auto start([&](size_t lane) {
+    active[lane] = next_job != count;
+    if (!active[lane])
+      return;
+    StartLane(jobs[next_job++], lanes[lane]);
+    for (size_t i(0); i != 8; ++i)
+      state[i][lane] = kInitialState[i];
+    ++active_count;
+  });
+  for (size_t lane(0); lane != kLanes; ++lane)
+    start(lane);
+
+  while (active_count != 0) {
+    const byte* blocks[kLanes];
+    for (size_t lane(0); lane != kLanes; ++lane)
+      blocks[lane] = active[lane] ? CurrentBlock(lanes[lane]) : kIdleBlock;
+    CompressLanes<Vector, kLanes>(state, blocks);
+    for (size_t lane(0); lane != kLanes; ++lane) {
+      if (!active[lane] || !AdvanceLane(lanes[lane]))
+        continue;
+      for (size_t i(0); i != 8; ++i)
+        StoreBigEndian(state[i][lane], lanes[lane].job->digest + 8 * i);
+      --active_count;
+      start(lane);
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+void HashAvx2(const HashJob* jobs, size_t count) {
+  HashLanes<Vector4, 4>(jobs, count);
+}
+
+__attribute__((target("avx512f")))
+void HashAvx512(const HashJob* jobs, size_t count) {
+  HashLanes<Vector8, 8>(jobs, count);
+}
+
+Sha512Implementation DetectImplementation() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return Sha512Implementation::kAvx512;
+  if (__builtin_cpu_supports("avx2"))
+    return Sha512Implementation::kAvx2;
+  return Sha512Implementation::kPortable;
+}
+
+#undef MAIDSAFE_ENCRYPT_ROTR
+#undef MAIDSAFE_ENCRYPT_ALWAYS_INLINE
+
+#else
+
+Sha512Implementation DetectImplementation() { return Sha512Implementation::kPortable; }
+
+#endif
+
+}  // unnamed namespace
+
+Sha512Implementation BestSha512Implementation() {
+  static const Sha512Implementation kBest(DetectImplementation());
+  return kBest;
+}
+
+const char* Sha512ImplementationName(Sha512Implementation implementation) {
+  switch (implementation) {
+    case Sha512Implementation::kAvx2:
+      return "AVX2";
+    case Sha512Implementation::kAvx512:
+      return "AVX-512";
+    default:
+      return "portable";
+  }
+}
+
+size_t Sha512Lanes(Sha512Implementation implementation) {
+  switch (implementation) {
+    case Sha512Implementation::kAvx2:
+      return 4;
+    case Sha512Implementation::kAvx512:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+void Sha512Batch(const HashJob* jobs, size_t count, Sha512Implementation implementation) {
+  assert(implementation <= BestSha512Implementation());
+  // a single lane alone is slower than the portable implementation
+  if (count < 2)
+    implementation = Sha512Implementation::kPortable;
+  switch (implementation) {
+#ifdef MAIDSAFE_ENCRYPT_SHA512_LANES
+    case Sha512Implementation::kAvx2:
+      return HashAvx2(jobs, count);
+    case Sha512Implementation::kAvx512:
+      return HashAvx512(jobs, count);
+#endif
+    default:
+      return HashPortable(jobs, count);
+  }
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,61 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_SHA512_BATCH_H_
+#define MAIDSAFE_ENCRYPT_SHA512_BATCH_H_
+
+#include <cstddef>
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+enum class Sha512Implementation {
+  kPortable,  // CryptoPP, one message at a time
+  kAvx2,      // four messages at once
+  kAvx512     // eight messages at once
+};
+
+// The fastest implementation the CPU supports, determined once
+Sha512Implementation BestSha512Implementation();
+const char* Sha512ImplementationName(Sha512Implementation implementation);
+// How many messages "implementation" hashes at once
+size_t Sha512Lanes(Sha512Implementation implementation = BestSha512Implementation());
+
+// A message to be hashed, and where to write its 64-byte digest
+struct HashJob {
+  const byte* data;
+  size_t length;
+  byte* digest;
+};
+
+// Calculates the SHA-512 digest of each of the "count" messages.  With SIMD support, each lane of
+// the vector registers works through a different message, and a lane is handed the next message as
+// soon as it finishes its current one, so messages of different lengths keep all lanes busy.  A
+// lone message is hashed by the portable implementation.
+void Sha512Batch(const HashJob* jobs, size_t count,
+                 Sha512Implementation implementation = BestSha512Implementation());
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_SHA512_BATCH_H_
@@ -0,0 +1,130 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/aes_cfb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/aes.h"
+#include "cryptopp/modes.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/encrypt/config.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+ByteVector RandomBytes(size_t size) {
+  std::string random(RandomString(size));
+  return ByteVector(random.begin(), random.end());
+}
+
+std::vector<AesImplementation> SupportedImplementations() {
+  std::vector<AesImplementation> implementations(1, AesImplementation::kPortable);
+  if (BestAesImplementation() >= AesImplementation::kAesNi)
+    implementations.push_back(AesImplementation::kAesNi);
+  if (BestAesImplementation() >= AesImplementation::kVaes)
+    implementations.push_back(AesImplementation::kVaes);
+  return implementations;
+}
+
+// Processes "data" through "cipher" in place, in pieces of growing and unaligned sizes
+ByteVector ProcessInPieces(AesCfb& cipher, ByteVector data) {
+  size_t position(0), piece(1);
+  while (position != data.size()) {
+    size_t length(std::min(piece, data.size() - position));
+    cipher.ProcessData(data.data() + position, data.data() + position, length);
+    position += length;
+    piece = piece * 3 + 1;
+  }
+  return data;
+}
+
+}  // unnamed namespace
+
+TEST(AesCfbTest, BEH_MatchesCryptoPP) {
+  ByteVector key(RandomBytes(crypto::AES256_KeySize)), iv(RandomBytes(crypto::AES256_IVSize));
+  for (size_t length : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(17), size_t(127),
+                        size_t(128), size_t(129), size_t(1000), size_t(64 * 1024 + 3)}) {
+    ByteVector plain(RandomBytes(length)), expected(length);
+    CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption(key.data(), crypto::AES256_KeySize, iv.data())
+        .ProcessData(expected.data(), plain.data(), length);
+    for (AesImplementation implementation : SupportedImplementations()) {
+      SCOPED_TRACE(std::string(AesImplementationName(implementation)) + " " +
+                   std::to_string(length));
+      ByteVector cipher(length), decrypted(length);
+      AesCfb(key.data(), iv.data(), true, implementation)
+          .ProcessData(cipher.data(), plain.data(), length);
+      EXPECT_TRUE(expected == cipher);
+      AesCfb(key.data(), iv.data(), false, implementation)
+          .ProcessData(decrypted.data(), cipher.data(), length);
+      EXPECT_TRUE(plain == decrypted);
+
+      AesCfb encryptor(key.data(), iv.data(), true, implementation);
+      EXPECT_TRUE(expected == ProcessInPieces(encryptor, plain));
+      AesCfb decryptor(key.data(), iv.data(), false, implementation);
+      EXPECT_TRUE(plain == ProcessInPieces(decryptor, expected));
+    }
+  }
+}
+
+TEST(AesCfbTest, BEH_Rekey) {
+  ByteVector plain(RandomBytes(1000));
+  for (AesImplementation implementation : SupportedImplementations()) {
+    SCOPED_TRACE(AesImplementationName(implementation));
+    ByteVector key(RandomBytes(crypto::AES256_KeySize)), iv(RandomBytes(crypto::AES256_IVSize));
+    AesCfb encryptor(key.data(), iv.data(), true, implementation);
+    AesCfb decryptor(key.data(), iv.data(), false, implementation);
+    // rekeying part way through a block discards the rest of its keystream
+    ByteVector partial(7);
+    encryptor.ProcessData(partial.data(), plain.data(), partial.size());
+    decryptor.ProcessData(partial.data(), partial.data(), partial.size());
+
+    key = RandomBytes(crypto::AES256_KeySize);
+    iv = RandomBytes(crypto::AES256_IVSize);
+    ByteVector expected(plain.size());
+    AesCfb(key.data(), iv.data(), true, implementation)
+        .ProcessData(expected.data(), plain.data(), plain.size());
+    encryptor.Rekey(key.data(), iv.data());
+    EXPECT_TRUE(expected == ProcessInPieces(encryptor, plain));
+    decryptor.Rekey(key.data(), iv.data());
+    EXPECT_TRUE(plain == ProcessInPieces(decryptor, expected));
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
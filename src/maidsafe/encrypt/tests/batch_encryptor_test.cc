@@ -0,0 +1,137 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "boost/filesystem/fstream.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/encrypt/batch_encryptor.h"
+#include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/self_encryptor.h"
+#include "maidsafe/encrypt/tests/encrypt_test_base.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+FileReader StringReader(const std::string& content) {
+  auto position(std::make_shared<size_t>(0));
+  return [&content, position](char* data, uint32_t length) {
+    auto count(static_cast<uint32_t>(std::min<size_t>(length, content.size() - *position)));
+    std::memcpy(data, content.data() + *position, count);
+    *position += count;
+    return count;
+  };
+}
+
+}  // unnamed namespace
+
+class BatchEncryptorTest : public EncryptTestBase, public testing::Test {
+ protected:
+  void TearDown() override { self_encryptor_->Close(); }
+
+  std::string Decrypt(DataMap& data_map) {
+    std::string content(static_cast<size_t>(data_map.size()), 0);
+    SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+    if (!content.empty())
+      EXPECT_TRUE(self_encryptor.Read(&content[0], static_cast<uint32_t>(content.size()), 0));
+    self_encryptor.Close();
+    return content;
+  }
+};
+
+TEST_F(BatchEncryptorTest, FUNC_EncryptFiles) {
+  // a mix of content-only, three-chunk and larger files
+  const std::vector<uint32_t> kSizes{0, 10, 3 * kMinChunkSize - 1, 3 * kMinChunkSize, 5000,
+                                     3 * kMaxChunkSize - 1, 3 * kMaxChunkSize + 1,
+                                     5 * kMaxChunkSize};
+  std::vector<std::string> contents;
+  for (int i(0); i != 3; ++i) {
+    for (auto size : kSizes)
+      contents.push_back(RandomString(size));
+  }
+
+  std::vector<FileReader> readers;
+  for (const auto& content : contents)
+    readers.push_back(StringReader(content));
+  auto data_maps(EncryptFiles(readers, local_store_));
+  ASSERT_EQ(contents.size(), data_maps.size());
+  for (size_t i(0); i != contents.size(); ++i) {
+    // the same as encrypting the file alone
+    DataMap data_map;
+    {
+      SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+      if (!contents[i].empty()) {
+        EXPECT_TRUE(self_encryptor.Write(contents[i].data(),
+                                         static_cast<uint32_t>(contents[i].size()), 0));
+      }
+      self_encryptor.Close();
+    }
+    EXPECT_TRUE(data_map == data_maps[i]) << "file " << i;
+    EXPECT_TRUE(contents[i] == Decrypt(data_maps[i])) << "file " << i;
+  }
+}
+
+TEST_F(BatchEncryptorTest, FUNC_EncryptFilesFromDisk) {
+  const std::vector<uint32_t> kSizes{0, 5000, kMaxChunkSize, 3 * kMaxChunkSize + 1};
+  std::vector<std::string> contents;
+  std::vector<boost::filesystem::path> paths;
+  std::vector<FileReader> readers;
+  for (auto size : kSizes) {
+    contents.push_back(RandomString(size));
+    paths.push_back(*test_dir_ / ("file" + std::to_string(size)));
+    boost::filesystem::ofstream(paths.back(), std::ios::binary) << contents.back();
+  }
+  for (const auto& content : contents)
+    readers.push_back(StringReader(content));
+
+  auto data_maps(EncryptFiles(paths, local_store_));
+  auto expected(EncryptFiles(readers, local_store_));
+  ASSERT_EQ(contents.size(), data_maps.size());
+  for (size_t i(0); i != contents.size(); ++i) {
+    EXPECT_TRUE(expected[i] == data_maps[i]) << "file " << i;
+    EXPECT_TRUE(contents[i] == Decrypt(data_maps[i])) << "file " << i;
+  }
+
+  paths.push_back(*test_dir_ / "missing");
+  EXPECT_THROW(EncryptFiles(paths, local_store_), maidsafe_error);
+}
+
+TEST_F(BatchEncryptorTest, BEH_EncryptNoFiles) {
+  EXPECT_TRUE(EncryptFiles(std::vector<FileReader>(), local_store_).empty());
+  EXPECT_TRUE(EncryptFiles(std::vector<boost::filesystem::path>(), local_store_).empty());
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -16,14 +16,32 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include "boost/filesystem/operations.hpp"
 
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/filters.h"
+#include "cryptopp/gzip.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/make_unique.h"
 #include "maidsafe/common/test.h"
 
+#include "maidsafe/encrypt/aes_cfb.h"
+#include "maidsafe/encrypt/chunk_hash.h"
+#include "maidsafe/encrypt/gzip.h"
+#include "maidsafe/encrypt/sha512_batch.h"
 #include "maidsafe/encrypt/tests/encrypt_test_base.h"
 
 namespace fs = boost::filesystem;
@@ -60,6 +78,14 @@ class Benchmark : public EncryptTestBase, public testing::TestWithParam<uint32_t
               << BytesToDecimalSiUnits(kPieceSize_) << " pieces in " << (duration / 1000)
               << " milliseconds at a speed of " << BytesToDecimalSiUnits(rate) << "/s\n";
   }
+  // Replaces the initial self_encryptor_ with one writing a DataMap of the given version
+  void UseVersion(EncryptionAlgorithm version, ChunkCompression compression) {
+    self_encryptor_->Close();
+    data_map_.self_encryption_version = version;
+    data_map_.compression = compression;
+    self_encryptor_ =
+        maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_);
+  }
   void WriteThenRead(bool compressible) {
     chrono_time_point start_time(std::chrono::high_resolution_clock::now());
     for (uint32_t i(0); i < kTestDataSize_; i += kPieceSize_)
@@ -92,8 +118,146 @@ TEST_P(Benchmark, FUNC_BenchmarkIncompressible) {
   WriteThenRead(false);
 }
 
+TEST_P(Benchmark, FUNC_BenchmarkIncompressibleVersion1) {
+  UseVersion(EncryptionAlgorithm::kSelfEncryptionVersion1, ChunkCompression::kGzip);
+  memcpy(original_.get(), RandomString(kTestDataSize_).data(), kTestDataSize_);
+  WriteThenRead(false);
+}
+
+// Version 2 stores incompressible chunks without passing them through Gzip
+TEST_P(Benchmark, FUNC_BenchmarkIncompressibleVersion2) {
+  UseVersion(EncryptionAlgorithm::kSelfEncryptionVersion2, ChunkCompression::kGzip);
+  memcpy(original_.get(), RandomString(kTestDataSize_).data(), kTestDataSize_);
+  WriteThenRead(false);
+}
+
+TEST_P(Benchmark, FUNC_BenchmarkCompressibleLz4) {
+  UseVersion(EncryptionAlgorithm::kSelfEncryptionVersion2, ChunkCompression::kLz4);
+  memset(original_.get(), 'a', kTestDataSize_);
+  WriteThenRead(true);
+}
+
+TEST_P(Benchmark, FUNC_BenchmarkIncompressibleLz4) {
+  UseVersion(EncryptionAlgorithm::kSelfEncryptionVersion2, ChunkCompression::kLz4);
+  memcpy(original_.get(), RandomString(kTestDataSize_).data(), kTestDataSize_);
+  WriteThenRead(false);
+}
+
 INSTANTIATE_TEST_CASE_P(WriteRead, Benchmark, testing::Values(0, 4096, 65536, 1048576));
 
+// Times AES-256-CFB on one core over 1MiB chunks for each implementation the CPU supports
+TEST(AesCfb, FUNC_BenchmarkChunkCipher) {
+  const uint32_t kChunkSize(kMaxChunkSize), kChunkCount(64);
+  std::string chunk(RandomString(kChunkSize)), key(RandomString(crypto::AES256_KeySize)),
+      iv(RandomString(crypto::AES256_IVSize));
+  byte* data(reinterpret_cast<byte*>(&chunk[0]));
+  const byte* key_data(reinterpret_cast<const byte*>(key.data()));
+  const byte* iv_data(reinterpret_cast<const byte*>(iv.data()));
+  uint64_t portable_rate[2] = {0, 0};
+  for (int i(0); i <= static_cast<int>(BestAesImplementation()); ++i) {
+    AesImplementation implementation(static_cast<AesImplementation>(i));
+    for (bool encrypt : {true, false}) {
+      auto start_time(std::chrono::high_resolution_clock::now());
+      for (uint32_t j(0); j != kChunkCount; ++j)
+        AesCfb(key_data, iv_data, encrypt, implementation).ProcessData(data, data, kChunkSize);
+      auto stop_time(std::chrono::high_resolution_clock::now());
+      uint64_t duration(std::max<uint64_t>(
+          1, std::chrono::duration_cast<std::chrono::microseconds>(stop_time - start_time)
+                 .count()));
+      uint64_t rate((static_cast<uint64_t>(kChunkSize) * kChunkCount * 1000000) / duration);
+      if (implementation == AesImplementation::kPortable)
+        portable_rate[encrypt] = rate;
+      std::cout << (encrypt ? "Encrypted " : "Decrypted ")
+                << BytesToDecimalSiUnits(static_cast<uint64_t>(kChunkSize) * kChunkCount)
+                << " using " << AesImplementationName(implementation) << " AES at a speed of "
+                << BytesToDecimalSiUnits(rate) << "/s per core ("
+                << (static_cast<double>(rate) / portable_rate[encrypt]) << "x portable)\n";
+    }
+  }
+}
+
+// Times hashing 1MiB chunks on one core for each SHA-512 implementation the CPU supports, and for
+// the BLAKE2bp of self-encryption version 1
+TEST(Sha512Batch, FUNC_BenchmarkChunkHashes) {
+  const uint32_t kChunkSize(kMaxChunkSize), kChunkCount(64);
+  std::vector<std::string> chunks;
+  std::vector<std::array<byte, crypto::SHA512::DIGESTSIZE>> digests(kChunkCount);
+  std::vector<HashJob> jobs;
+  for (uint32_t i(0); i != kChunkCount; ++i) {
+    chunks.push_back(RandomString(kChunkSize));
+    jobs.push_back(HashJob{reinterpret_cast<const byte*>(chunks.back().data()), kChunkSize,
+                           digests[i].data()});
+  }
+  uint64_t portable_rate(0);
+  for (int i(0); i <= static_cast<int>(BestSha512Implementation()); ++i) {
+    Sha512Implementation implementation(static_cast<Sha512Implementation>(i));
+    auto start_time(std::chrono::high_resolution_clock::now());
+    Sha512Batch(jobs.data(), jobs.size(), implementation);
+    auto stop_time(std::chrono::high_resolution_clock::now());
+    uint64_t duration(std::max<uint64_t>(
+        1,
+        std::chrono::duration_cast<std::chrono::microseconds>(stop_time - start_time).count()));
+    uint64_t rate((static_cast<uint64_t>(kChunkSize) * kChunkCount * 1000000) / duration);
+    if (implementation == Sha512Implementation::kPortable)
+      portable_rate = rate;
+    std::cout << "Hashed " << kChunkCount << " chunks using "
+              << Sha512ImplementationName(implementation) << " SHA-512 at a speed of "
+              << BytesToDecimalSiUnits(rate) << "/s per core ("
+              << (static_cast<double>(rate) / portable_rate) << "x portable)\n";
+  }
+  auto start_time(std::chrono::high_resolution_clock::now());
+  CalculateChunkHashes(EncryptionAlgorithm::kSelfEncryptionVersion1, jobs.data(), jobs.size());
+  auto stop_time(std::chrono::high_resolution_clock::now());
+  uint64_t duration(std::max<uint64_t>(
+      1, std::chrono::duration_cast<std::chrono::microseconds>(stop_time - start_time).count()));
+  uint64_t rate((static_cast<uint64_t>(kChunkSize) * kChunkCount * 1000000) / duration);
+  std::cout << "Hashed " << kChunkCount << " chunks using BLAKE2bp at a speed of "
+            << BytesToDecimalSiUnits(rate) << "/s per core ("
+            << (static_cast<double>(rate) / portable_rate) << "x portable SHA-512)\n";
+}
+
+// Times gzip decompression of 1MiB chunks compressed as by version 0 on one core, streaming through
+// CryptoPP's Gunzip and then with the backend chosen at build time
+TEST(Gzip, FUNC_BenchmarkChunkDecompression) {
+  const uint32_t kChunkSize(kMaxChunkSize), kChunkCount(64);
+  const std::vector<std::string> kWords{"self", "encrypting ", "chunk ", "of ", "the ", "data map ",
+                                        "\n", "0x", "AES ", "pre-hash "};
+  std::vector<std::string> compressed;
+  for (uint32_t i(0); i != kChunkCount; ++i) {
+    std::string chunk;
+    while (chunk.size() < kChunkSize)
+      chunk += kWords[RandomUint32() % kWords.size()] + std::to_string(RandomUint32() % 1000);
+    chunk.resize(kChunkSize);
+    compressed.emplace_back();
+    CryptoPP::Gzip compressor(new CryptoPP::StringSink(compressed.back()), 1);
+    compressor.Put2(reinterpret_cast<const byte*>(chunk.data()), kChunkSize, -1, true);
+  }
+  ByteVector decompressed(kChunkSize);
+
+  auto rate([&](const std::function<void(const std::string&)>& decompress) {
+    auto start_time(std::chrono::high_resolution_clock::now());
+    for (const auto& chunk : compressed)
+      decompress(chunk);
+    auto stop_time(std::chrono::high_resolution_clock::now());
+    uint64_t duration(std::max<uint64_t>(
+        1, std::chrono::duration_cast<std::chrono::microseconds>(stop_time - start_time)
+               .count()));
+    return (static_cast<uint64_t>(kChunkSize) * kChunkCount * 1000000) / duration;
+  });
+  uint64_t cryptopp_rate(rate([&](const std::string& chunk) {
+    CryptoPP::Gunzip decompressor(new CryptoPP::ArraySink(decompressed.data(), kChunkSize));
+    decompressor.Put2(reinterpret_cast<const byte*>(chunk.data()), chunk.size(), -1, true);
+  }));
+  uint64_t backend_rate(rate([&](const std::string& chunk) {
+    ASSERT_TRUE(GzipDecompress(reinterpret_cast<const byte*>(chunk.data()), chunk.size(),
+                               decompressed.data(), kChunkSize));
+  }));
+  std::cout << "Decompressed " << kChunkCount << " chunks using CryptoPP at a speed of "
+            << BytesToDecimalSiUnits(cryptopp_rate) << "/s per core, and using " << GzipBackend()
+            << " at a speed of " << BytesToDecimalSiUnits(backend_rate) << "/s per core ("
+            << (static_cast<double>(backend_rate) / cryptopp_rate) << "x)\n";
+}
+
 // This test is to allow confirmation that memory usage is capped at an
 // acceptable level.  While the test is running, memory usage must be visually
 // monitored.
@@ -0,0 +1,99 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/blake2bp.h"
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+typedef std::array<byte, Blake2bp::DIGESTSIZE> Digest;
+
+std::string Hex(const Digest& digest) {
+  std::string hex;
+  char buffer[3];
+  for (byte value : digest) {
+    std::snprintf(buffer, sizeof(buffer), "%02x", value);
+    hex += buffer;
+  }
+  return hex;
+}
+
+Digest HashOf(const std::string& data) {
+  Digest digest;
+  Blake2bp().CalculateDigest(digest.data(), reinterpret_cast<const byte*>(data.data()),
+                             data.size());
+  return digest;
+}
+
+}  // unnamed namespace
+
+TEST(Blake2bpTest, BEH_KnownDigests) {
+  EXPECT_EQ(
+      "b5ef811a8038f70b628fa8b294daae7492b1ebe343a80eaabbf1f6ae664dd67b9d90b0120791eab81dc96985f288"
+      "49f6a305186a85501b405114bfa678df9380",
+      Hex(HashOf("")));
+  EXPECT_EQ(
+      "b91a6b66ae87526c400b0a8b53774dc65284ad8f6575f8148ff93dff943a6ecd8362130f22d6dae633aa0f91df4a"
+      "c89aaff31d0f1b923c898e82025dedbdad6e",
+      Hex(HashOf("abc")));
+  // long enough for every leaf to have several blocks, with a partial block at the end
+  std::string data(3000, 0);
+  for (size_t i(0); i != data.size(); ++i)
+    data[i] = static_cast<char>(i % 251);
+  EXPECT_EQ(
+      "e7e2e0eeabc58ca7228a4fa20580a6e34ecb754ff2cc23123a6547646e88dce7e03573c2140d272dc6a4c4994e2a"
+      "7242c3358787b2615b8f2cf1b62561c5e6cb",
+      Hex(HashOf(data)));
+}
+
+TEST(Blake2bpTest, BEH_PiecewiseUpdates) {
+  // lengths either side of whole blocks and stripes, fed in pieces which don't respect either
+  std::string data(RandomString(20000));
+  Blake2bp hash;
+  for (size_t length : {1, 127, 128, 129, 511, 512, 513, 895, 896, 897, 1024, 1025, 4000, 20000}) {
+    Digest expected(HashOf(data.substr(0, length)));
+    for (size_t piece : {1, 100, 128, 700}) {
+      for (size_t offset(0); offset < length; offset += piece) {
+        hash.Update(reinterpret_cast<const byte*>(data.data()) + offset,
+                    std::min(piece, length - offset));
+      }
+      Digest digest;
+      hash.Final(digest.data());
+      EXPECT_TRUE(expected == digest) << "length " << length << " in pieces of " << piece;
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
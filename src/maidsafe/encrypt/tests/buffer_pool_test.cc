@@ -0,0 +1,84 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/buffer_pool.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+TEST(BufferPoolTest, BEH_ReusesBySizeClass) {
+  BufferPool pool(2);
+  Buffer small(pool.Get(64)), chunk(pool.Get(kMaxChunkSize - 1000));
+  EXPECT_EQ(64U, small.size());
+  EXPECT_EQ(64U, small.capacity());
+  EXPECT_EQ(kMaxChunkSize - 1000, chunk.size());
+  EXPECT_EQ(kMaxChunkSize, chunk.capacity());
+  for (const Buffer* buffer : {&small, &chunk})
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(buffer->data()) % Buffer::kAlignment);
+  const byte* small_data(small.data());
+  const byte* chunk_data(chunk.data());
+  pool.Return(std::move(small));
+  pool.Return(std::move(chunk));
+
+  // a buffer comes back for any size in its class, and never for another class
+  auto allocations(BufferAllocations());
+  Buffer large(pool.Get(kMaxChunkSize));
+  EXPECT_EQ(chunk_data, large.data());
+  Buffer medium(pool.Get(65));
+  EXPECT_NE(small_data, medium.data());
+  EXPECT_EQ(128U, medium.capacity());
+  Buffer tiny(pool.Get(1));
+  EXPECT_EQ(small_data, tiny.data());
+  EXPECT_EQ(1U, tiny.size());
+  EXPECT_EQ(allocations + 1, BufferAllocations());
+
+  // at most two chunk-sized buffers are kept, but up to 1 MiB's worth of small ones
+  Buffer extra(pool.Get(kMaxChunkSize));
+  pool.Return(std::move(large));
+  pool.Return(std::move(extra));
+  pool.Return(Buffer(kMaxChunkSize));
+  std::vector<Buffer> small_buffers;
+  for (int i(0); i != 100; ++i)
+    small_buffers.push_back(pool.Get(128));
+  for (auto& buffer : small_buffers)
+    pool.Return(std::move(buffer));
+  small_buffers.clear();
+  allocations = BufferAllocations();
+  Buffer first(pool.Get(kMaxChunkSize)), second(pool.Get(kMaxChunkSize - 1)),
+      third(pool.Get(kMaxChunkSize));
+  EXPECT_EQ(allocations + 1, BufferAllocations());
+  for (int i(0); i != 100; ++i)
+    small_buffers.push_back(pool.Get(128));
+  EXPECT_EQ(allocations + 1, BufferAllocations());
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
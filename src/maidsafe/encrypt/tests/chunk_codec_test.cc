@@ -0,0 +1,238 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/aes.h"
+#include "cryptopp/filters.h"
+#include "cryptopp/gzip.h"
+#include "cryptopp/modes.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/encrypt/chunk_codec.h"
+#include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/xor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+// The version 0 encoding, as produced by a chain of CryptoPP filters, optionally without the Gzip
+std::string EncodeWithFilters(const std::string& data, bool compress, byte* key, byte* iv,
+                              byte* pad, int level = 1) {
+  CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption encryptor(key, crypto::AES256_KeySize, iv);
+  std::string encoded;
+  auto encrypting_filter(new CryptoPP::StreamTransformationFilter(
+      encryptor, new XORFilter(new CryptoPP::StringSink(encoded), pad)));
+  if (compress) {
+    CryptoPP::Gzip filter(encrypting_filter, level);
+    filter.Put2(reinterpret_cast<const byte*>(data.data()), data.size(), -1, true);
+  } else {
+    CryptoPP::StringSource(data, true, encrypting_filter);
+  }
+  return encoded;
+}
+
+std::string Repeated(const std::string& pattern, uint32_t size) {
+  std::string repeated;
+  while (repeated.size() < size)
+    repeated += pattern;
+  repeated.resize(size);
+  return repeated;
+}
+
+}  // unnamed namespace
+
+TEST(ChunkCodecTest, BEH_MatchesFilterChain) {
+  std::array<byte, crypto::AES256_KeySize> key;
+  std::array<byte, crypto::AES256_IVSize> iv;
+  std::array<byte, kPadSize> pad;
+  std::string random(RandomString(key.size() + iv.size() + pad.size()));
+  auto next(std::copy(random.begin(), random.begin() + key.size(), key.begin()) - key.begin());
+  std::copy(random.begin() + next, random.begin() + next + iv.size(), iv.begin());
+  std::copy(random.begin() + next + iv.size(), random.end(), pad.begin());
+
+  for (uint32_t size : {1U, 100U, kMinChunkSize, 100000U, kMaxChunkSize}) {
+    // both incompressible and highly compressible content is always compressed by versions 0 and 1
+    for (const std::string& data : {RandomString(size), std::string(size, 'a')}) {
+      for (EncryptionAlgorithm version : {EncryptionAlgorithm::kSelfEncryptionVersion0,
+                                          EncryptionAlgorithm::kSelfEncryptionVersion1}) {
+        EncodedChunk encoded(EncodeChunk(reinterpret_cast<const byte*>(data.data()), size, version,
+                                         ChunkCompression::kGzip, 1, key.data(), iv.data(),
+                                         pad.data()));
+        EXPECT_TRUE(encoded.compressed) << size;
+        EXPECT_TRUE(EncodeWithFilters(data, true, key.data(), iv.data(), pad.data()) ==
+                    encoded.content)
+            << size;
+
+        ByteVector decoded(size);
+        DecodeChunk(reinterpret_cast<const byte*>(encoded.content.data()), encoded.content.size(),
+                    ChunkCompression::kGzip, true, key.data(), iv.data(), pad.data(),
+                    decoded.data(), size);
+        EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(),
+                               reinterpret_cast<const byte*>(data.data())))
+            << size;
+      }
+    }
+  }
+}
+
+TEST(ChunkCodecTest, BEH_LevelDoesNotCarryOver) {
+  std::array<byte, crypto::AES256_KeySize> key;
+  std::array<byte, crypto::AES256_IVSize> iv;
+  std::array<byte, kPadSize> pad;
+  std::string random(RandomString(key.size() + iv.size() + pad.size()));
+  auto next(std::copy(random.begin(), random.begin() + key.size(), key.begin()) - key.begin());
+  std::copy(random.begin() + next, random.begin() + next + iv.size(), iv.begin());
+  std::copy(random.begin() + next + iv.size(), random.end(), pad.begin());
+
+  // runs of random content make the deflater drop to storing, and the repeated runs after them make
+  // it return to the level it was initialised with
+  std::string data;
+  while (data.size() < kMaxChunkSize)
+    data += RandomString(64 * 1024) + Repeated("compressible ", 64 * 1024);
+  data.resize(kMaxChunkSize);
+
+  // both encodings run on this thread, so the second reuses the compressor the first set up
+  for (int level : {9, 1, 9}) {
+    EncodedChunk encoded(EncodeChunk(reinterpret_cast<const byte*>(data.data()), kMaxChunkSize,
+                                     EncryptionAlgorithm::kSelfEncryptionVersion1,
+                                     ChunkCompression::kGzip, level, key.data(), iv.data(),
+                                     pad.data()));
+    EXPECT_TRUE(EncodeWithFilters(data, true, key.data(), iv.data(), pad.data(), level) ==
+                encoded.content)
+        << level;
+  }
+}
+
+TEST(ChunkCodecTest, BEH_IncompressibleDoesNotCarryOver) {
+  std::array<byte, crypto::AES256_KeySize> key;
+  std::array<byte, crypto::AES256_IVSize> iv;
+  std::array<byte, kPadSize> pad;
+  std::string random(RandomString(key.size() + iv.size() + pad.size()));
+  auto next(std::copy(random.begin(), random.begin() + key.size(), key.begin()) - key.begin());
+  std::copy(random.begin() + next, random.begin() + next + iv.size(), iv.begin());
+  std::copy(random.begin() + next + iv.size(), random.end(), pad.begin());
+
+  // the first chunk ends with the deflater storing rather than compressing; the second, at the same
+  // level on the same thread, must still be compressed as a fresh compressor would
+  std::string ending_random(Repeated("compressible ", kMaxChunkSize / 2) +
+                            RandomString(kMaxChunkSize / 2));
+  std::string compressible(kMaxChunkSize, 'a');
+  EncodedChunk encoded;
+  for (const std::string& data : {ending_random, compressible}) {
+    encoded = EncodeChunk(reinterpret_cast<const byte*>(data.data()), kMaxChunkSize,
+                          EncryptionAlgorithm::kSelfEncryptionVersion1, ChunkCompression::kGzip, 1,
+                          key.data(), iv.data(), pad.data());
+    EXPECT_TRUE(EncodeWithFilters(data, true, key.data(), iv.data(), pad.data()) ==
+                encoded.content);
+  }
+  EXPECT_LT(encoded.content.size(), kMaxChunkSize / 100);
+}
+
+TEST(ChunkCodecTest, BEH_StoresIncompressibleUncompressed) {
+  std::array<byte, crypto::AES256_KeySize> key;
+  std::array<byte, crypto::AES256_IVSize> iv;
+  std::array<byte, kPadSize> pad;
+  std::string random(RandomString(key.size() + iv.size() + pad.size()));
+  auto next(std::copy(random.begin(), random.begin() + key.size(), key.begin()) - key.begin());
+  std::copy(random.begin() + next, random.begin() + next + iv.size(), iv.begin());
+  std::copy(random.begin() + next + iv.size(), random.end(), pad.begin());
+
+  for (uint32_t size : {1U, 100U, kMinChunkSize, 100000U, kMaxChunkSize}) {
+    // from version 2, incompressible content is left uncompressed once there's enough of it to
+    // judge, while highly compressible content is compressed, as is random content that repeats
+    std::vector<std::pair<std::string, bool>> inputs{
+        {RandomString(size), size < 100000}, {std::string(size, 'a'), true},
+        {Repeated(RandomString(1000), size), true}};
+    for (const auto& input : inputs) {
+      const std::string& data(input.first);
+      EncodedChunk encoded(EncodeChunk(reinterpret_cast<const byte*>(data.data()), size,
+                                       EncryptionAlgorithm::kSelfEncryptionVersion2,
+                                       ChunkCompression::kGzip, 1, key.data(), iv.data(),
+                                       pad.data()));
+      if (size >= 100000)
+        EXPECT_EQ(input.second, encoded.compressed) << size;
+      if (!encoded.compressed) {
+        EXPECT_TRUE(EncodeWithFilters(data, false, key.data(), iv.data(), pad.data()) ==
+                    encoded.content)
+            << size;
+      }
+
+      ByteVector decoded(size);
+      DecodeChunk(reinterpret_cast<const byte*>(encoded.content.data()), encoded.content.size(),
+                  ChunkCompression::kGzip, encoded.compressed, key.data(), iv.data(), pad.data(),
+                  decoded.data(), size);
+      EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(),
+                             reinterpret_cast<const byte*>(data.data())))
+          << size;
+    }
+  }
+}
+
+TEST(ChunkCodecTest, BEH_Lz4RoundTrip) {
+  std::string random(RandomString(crypto::AES256_KeySize + crypto::AES256_IVSize + kPadSize));
+  const byte* key(reinterpret_cast<const byte*>(random.data()));
+  const byte* iv(key + crypto::AES256_KeySize);
+  const byte* pad(iv + crypto::AES256_IVSize);
+
+  for (uint32_t size : {1U, 100U, kMinChunkSize, 100000U, kMaxChunkSize}) {
+    for (const std::string& data : {RandomString(size), std::string(size, 'a')}) {
+      EncodedChunk encoded(EncodeChunk(reinterpret_cast<const byte*>(data.data()), size,
+                                       EncryptionAlgorithm::kSelfEncryptionVersion2,
+                                       ChunkCompression::kLz4, 1, key, iv, pad));
+      ByteVector decoded(size);
+      DecodeChunk(reinterpret_cast<const byte*>(encoded.content.data()), encoded.content.size(),
+                  ChunkCompression::kLz4, encoded.compressed, key, iv, pad, decoded.data(), size);
+      EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(),
+                             reinterpret_cast<const byte*>(data.data())))
+          << size;
+      // content altered in storage fails to decode rather than giving the wrong data
+      encoded.content.pop_back();
+      EXPECT_THROW(DecodeChunk(reinterpret_cast<const byte*>(encoded.content.data()),
+                               encoded.content.size(), ChunkCompression::kLz4, encoded.compressed,
+                               key, iv, pad, decoded.data(), size),
+                   maidsafe_error)
+          << size;
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
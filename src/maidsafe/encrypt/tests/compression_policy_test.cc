@@ -0,0 +1,98 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/compression_policy.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+const uint64_t kChunkSize(1024 * 1024);
+
+// Records "count" chunks at the policy's current level, each compressing to "ratio" (less a little
+// per level) and each taking "duration" per level, returning the level reached
+int Feed(CompressionPolicy& policy, int count, double ratio, std::chrono::milliseconds duration) {
+  for (int i(0); i != count; ++i) {
+    int level(policy.Level());
+    policy.Record(level, kChunkSize,
+                  static_cast<uint64_t>(kChunkSize * (ratio - 0.02 * level)), duration * level);
+  }
+  return policy.Level();
+}
+
+}  // unnamed namespace
+
+TEST(CompressionPolicyTest, BEH_FixedLevel) {
+  CompressionPolicy default_policy;
+  EXPECT_FALSE(default_policy.adaptive());
+  EXPECT_EQ(CompressionPolicy::kFastestLevel, default_policy.Level());
+  CompressionPolicy policy(6);
+  EXPECT_EQ(6, Feed(policy, 100, 0.5, std::chrono::milliseconds(1)));
+  EXPECT_EQ(6, Feed(policy, 100, 0.5, std::chrono::milliseconds(1000)));
+
+  EXPECT_THROW(CompressionPolicy(0), maidsafe_error);
+  EXPECT_THROW(CompressionPolicy(CompressionPolicy::kBestLevel + 1), maidsafe_error);
+  EXPECT_THROW(CompressionPolicy(0, 4), maidsafe_error);
+}
+
+TEST(CompressionPolicyTest, BEH_AdaptsToBottleneck) {
+  // with four cores each compressing 100MB/s at level 1 and a 10MB/s store, the store is the
+  // bottleneck at every level, so the level climbs to the best
+  CompressionPolicy policy(10 * 1000 * 1000, 4);
+  EXPECT_TRUE(policy.adaptive());
+  EXPECT_EQ(CompressionPolicy::kFastestLevel, policy.Level());
+  EXPECT_EQ(CompressionPolicy::kBestLevel, Feed(policy, 200, 0.5, std::chrono::milliseconds(10)));
+
+  // once compression slows to 1MB/s per core at level 1, the cores are the bottleneck, so the
+  // level falls to the fastest
+  EXPECT_EQ(CompressionPolicy::kFastestLevel,
+            Feed(policy, 500, 0.5, std::chrono::milliseconds(1000)));
+
+  // and it climbs again once the pressure is off
+  EXPECT_EQ(CompressionPolicy::kBestLevel, Feed(policy, 500, 0.5, std::chrono::milliseconds(10)));
+}
+
+TEST(CompressionPolicyTest, BEH_SettlesBetweenBottlenecks) {
+  // with one core compressing 100MB/s at level 1 falling to 11MB/s at level 9, and a 20MB/s store,
+  // the best throughput is at a middle level, where the level settles
+  CompressionPolicy policy(20 * 1000 * 1000, 1);
+  int level(Feed(policy, 200, 0.5, std::chrono::milliseconds(10)));
+  EXPECT_GT(level, CompressionPolicy::kFastestLevel);
+  EXPECT_LT(level, CompressionPolicy::kBestLevel);
+  for (int i(0); i != 10; ++i) {
+    int next(Feed(policy, 20, 0.5, std::chrono::milliseconds(10)));
+    EXPECT_LE(std::abs(next - level), 1);
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
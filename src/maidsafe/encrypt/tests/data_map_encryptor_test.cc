@@ -58,6 +58,30 @@ namespace {
 
 typedef std::pair<uint32_t, uint32_t> SizeAndOffset;
 const int g_num_procs(Concurrency());
+
+// The layout of ChunkDetails prior to digests being held inline
+struct LegacyChunkDetails {
+  template <typename Archive>
+  Archive& serialize(Archive& archive) {
+    return archive(hash, pre_hash, storage_state, size);
+  }
+
+  ByteVector hash, pre_hash;
+  uint32_t storage_state, size;
+};
+
+// The layout of DataMap prior to the compression being recorded
+struct LegacyDataMap {
+  template <typename Archive>
+  Archive& serialize(Archive& archive) {
+    return archive(self_encryption_version, chunks, content);
+  }
+
+  EncryptionAlgorithm self_encryption_version;
+  std::vector<ChunkDetails> chunks;
+  ByteVector content;
+};
+
 }  // unnamed namespace
 
 class EncryptDataMapTest : public EncryptTestBase, public testing::Test {
@@ -91,6 +115,67 @@ TEST_F(EncryptDataMapTest, FUNC_SerialiseParseDataMap) {
     EXPECT_EQ(decrypted_[i], original_[i]);
 }
 
+TEST_F(EncryptDataMapTest, BEH_SerialisedChunkDetailsCompatible) {
+  const std::string kHash(RandomString(crypto::SHA512::DIGESTSIZE));
+  LegacyChunkDetails legacy;
+  legacy.hash.assign(std::begin(kHash), std::end(kHash));
+  legacy.storage_state = ChunkDetails::kPending;
+  legacy.size = kMaxChunkSize;
+
+  ChunkDetails chunk;
+  chunk.hash.assign(std::begin(kHash), std::end(kHash));
+  chunk.storage_state = ChunkDetails::kPending;
+  chunk.size = kMaxChunkSize;
+  EXPECT_EQ(Serialise(legacy), Serialise(chunk));
+
+  ChunkDetails parsed(Parse<ChunkDetails>(Serialise(legacy)));
+  EXPECT_EQ(chunk.hash, parsed.hash);
+  EXPECT_TRUE(parsed.pre_hash.empty());
+  EXPECT_EQ(ChunkDetails::kPending, parsed.storage_state);
+  EXPECT_EQ(kMaxChunkSize, parsed.size);
+  EXPECT_TRUE(parsed.compressed);
+
+  // chunks stored uncompressed are flagged in the storage state
+  chunk.compressed = false;
+  parsed = Parse<ChunkDetails>(Serialise(chunk));
+  EXPECT_FALSE(parsed.compressed);
+  EXPECT_EQ(ChunkDetails::kPending, parsed.storage_state);
+
+  legacy.storage_state = 0x200;
+  EXPECT_THROW(Parse<ChunkDetails>(Serialise(legacy)), maidsafe_error);
+  legacy.storage_state = ChunkDetails::kPending;
+  legacy.pre_hash.resize(crypto::SHA512::DIGESTSIZE - 1);
+  EXPECT_THROW(Parse<ChunkDetails>(Serialise(legacy)), maidsafe_error);
+  EXPECT_NO_THROW(self_encryptor_->Close());
+}
+
+TEST_F(EncryptDataMapTest, BEH_SerialisedDataMapCompatible) {
+  // maps of versions 0 and 1 keep their layout, and are always read as using gzip
+  LegacyDataMap legacy;
+  legacy.self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion1;
+  legacy.chunks.resize(3);
+  legacy.chunks[0].size = kMaxChunkSize;
+  DataMap data_map;
+  data_map.self_encryption_version = legacy.self_encryption_version;
+  data_map.chunks = legacy.chunks;
+  EXPECT_EQ(Serialise(legacy), Serialise(data_map));
+  EXPECT_TRUE(data_map == Parse<DataMap>(Serialise(legacy)));
+
+  // later versions record the compression
+  data_map.self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion2;
+  data_map.compression = ChunkCompression::kLz4;
+  DataMap parsed(Parse<DataMap>(Serialise(data_map)));
+  EXPECT_EQ(ChunkCompression::kLz4, parsed.compression);
+  EXPECT_TRUE(data_map == parsed);
+
+  // only later versions store chunks uncompressed
+  data_map.chunks[1].compressed = false;
+  EXPECT_FALSE(Parse<DataMap>(Serialise(data_map)).chunks[1].compressed);
+  data_map.self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion1;
+  EXPECT_THROW(Parse<DataMap>(Serialise(data_map)), maidsafe_error);
+  EXPECT_NO_THROW(self_encryptor_->Close());
+}
+
 TEST_F(EncryptDataMapTest, FUNC_EncryptDecryptDataMap) {
   // TODO(Fraser#5#): 2012-01-05 - Test failure cases also.
   EXPECT_TRUE(self_encryptor_->Write(&original_[0], kDataSize_, 0));
@@ -0,0 +1,160 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/gzip.h"
+
+#include <string>
+#include <vector>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/filters.h"
+#include "cryptopp/gzip.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+ByteVector ToBytes(const std::string& data) { return ByteVector(data.begin(), data.end()); }
+
+// Compressed by CryptoPP, as version 0 chunks are
+ByteVector CompressWithCryptoPP(const std::string& data, int level) {
+  std::string compressed;
+  CryptoPP::Gzip compressor(new CryptoPP::StringSink(compressed), level);
+  compressor.Put2(reinterpret_cast<const byte*>(data.data()), data.size(), -1, true);
+  return ToBytes(compressed);
+}
+
+bool Decompress(const ByteVector& compressed, std::string& data) {
+  return GzipDecompress(compressed.data(), compressed.size(), reinterpret_cast<byte*>(&data[0]),
+                        data.size());
+}
+
+}  // unnamed namespace
+
+TEST(GzipTest, BEH_Crc32) {
+  const std::string kCheck("123456789");
+  EXPECT_EQ(0xcbf43926, Crc32(reinterpret_cast<const byte*>(kCheck.data()), kCheck.size()));
+  EXPECT_EQ(0U, Crc32(nullptr, 0));
+  // the sliced and bytewise paths agree however the input is split
+  const std::string kData(RandomString(1000));
+  const byte* data(reinterpret_cast<const byte*>(kData.data()));
+  uint32_t expected(Crc32(data, kData.size()));
+  std::string misaligned(' ' + kData);
+  EXPECT_EQ(expected,
+            Crc32(reinterpret_cast<const byte*>(misaligned.data()) + 1, misaligned.size() - 1));
+}
+
+TEST(GzipTest, BEH_KnownStream) {
+  // "a" as a single fixed-Huffman block, with the header naming a file and carrying extra fields
+  const ByteVector kPlain{0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x4b,
+                          0x04, 0x00, 0x43, 0xbe, 0xb7, 0xe8, 0x01, 0x00, 0x00, 0x00};
+  ByteVector decorated(kPlain.begin(), kPlain.begin() + 10);
+  decorated[3] = 0x0c;
+  const ByteVector kExtraAndName{0x02, 0x00, 'x', 'y', 'a', '.', 't', 'x', 't', '\0'};
+  decorated.insert(decorated.end(), kExtraAndName.begin(), kExtraAndName.end());
+  decorated.insert(decorated.end(), kPlain.begin() + 10, kPlain.end());
+  for (const auto& compressed : {kPlain, decorated}) {
+    std::string decompressed(1, 0);
+    EXPECT_TRUE(Decompress(compressed, decompressed));
+    EXPECT_EQ("a", decompressed);
+  }
+}
+
+TEST(GzipTest, BEH_DynamicBlockWithoutDistances) {
+  // "abba" as a dynamic block whose distance code lengths are all zero, since it has no matches
+  const ByteVector kLiteralsOnly{0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x05,
+                                 0xc0, 0x01, 0x09, 0x00, 0x00, 0x00, 0x80, 0xa0, 0xad, 0xf6, 0x7f,
+                                 0x44, 0x28, 0x03, 0xdf, 0x08, 0xf3, 0x84, 0x04, 0x00, 0x00, 0x00};
+  std::string decompressed(4, 0);
+  EXPECT_TRUE(Decompress(kLiteralsOnly, decompressed));
+  EXPECT_EQ("abba", decompressed);
+
+  // a block which again has no distance codes, but does have a length code, used for a match
+  const ByteVector kMatchWithoutDistance{
+      0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x0d, 0xc0, 0x01, 0x09, 0x00,
+      0x00, 0x00, 0x80, 0xa0, 0xad, 0xfe, 0x3f, 0x51, 0x38, 0x45, 0xe5, 0x98, 0xad, 0x04, 0x00,
+      0x00, 0x00};
+  EXPECT_FALSE(Decompress(kMatchWithoutDistance, decompressed));
+}
+
+TEST(GzipTest, BEH_CompatibleWithCryptoPP) {
+  std::string text;
+  while (text.size() < 300000)
+    text += "self-encrypting " + std::to_string(text.size() % 977) + " ";
+  std::vector<std::string> inputs{std::string(), "a", std::string(100000, 'c'),
+                                  RandomString(100000), text,
+                                  RandomString(70000) + text.substr(0, 70000)};
+  // level 0 gives stored blocks, 1 mostly fixed Huffman codes and higher levels dynamic ones
+  for (int level : {0, 1, 6, 9}) {
+    for (const auto& data : inputs) {
+      ByteVector compressed(CompressWithCryptoPP(data, level));
+      std::string decompressed(data.size(), 0);
+      EXPECT_TRUE(Decompress(compressed, decompressed)) << level << ' ' << data.size();
+      EXPECT_TRUE(data == decompressed) << level << ' ' << data.size();
+    }
+  }
+}
+
+TEST(GzipTest, BEH_RejectsMalformed) {
+  const std::string kData(std::string(1000, 'a') + RandomString(1000));
+  ByteVector compressed(CompressWithCryptoPP(kData, 6));
+  std::string decompressed(kData.size(), 0);
+  ASSERT_TRUE(Decompress(compressed, decompressed));
+
+  // truncated input, or a different original size
+  ByteVector truncated(compressed.begin(), compressed.end() - 1);
+  EXPECT_FALSE(Decompress(truncated, decompressed));
+  std::string shorter(kData.size() - 1, 0), longer(kData.size() + 1, 0);
+  EXPECT_FALSE(Decompress(compressed, shorter));
+  EXPECT_FALSE(Decompress(compressed, longer));
+
+  // a corrupted CRC, size or header
+  for (size_t index : {size_t(0), size_t(2), compressed.size() - 8, compressed.size() - 1}) {
+    ByteVector corrupted(compressed);
+    corrupted[index] ^= 0x01;
+    EXPECT_FALSE(Decompress(corrupted, decompressed)) << index;
+  }
+  // and corrupted deflate data, which is rejected unless the change is immaterial, such as to a
+  // code length of a symbol never used
+  for (size_t index(10); index < compressed.size() - 8; index += 7) {
+    ByteVector corrupted(compressed);
+    corrupted[index] ^= 0x10;
+    if (Decompress(corrupted, decompressed)) {
+      EXPECT_EQ(kData, decompressed) << index;
+    }
+  }
+  EXPECT_FALSE(Decompress(ByteVector(), decompressed));
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
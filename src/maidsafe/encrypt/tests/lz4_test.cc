@@ -0,0 +1,100 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/lz4.h"
+
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+ByteVector Compress(const std::string& data) {
+  ByteVector compressed(Lz4CompressBound(data.size()));
+  compressed.resize(
+      Lz4Compress(reinterpret_cast<const byte*>(data.data()), data.size(), compressed.data()));
+  return compressed;
+}
+
+bool Decompress(const ByteVector& compressed, std::string& data) {
+  return Lz4Decompress(compressed.data(), compressed.size(),
+                       reinterpret_cast<byte*>(&data[0]), data.size());
+}
+
+}  // unnamed namespace
+
+TEST(Lz4Test, BEH_KnownBlock) {
+  // a literal and an overlapping match, then the five literals every block must end with
+  const ByteVector kExpected{0x1a, 'a', 0x01, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a'};
+  const std::string kData(20, 'a');
+  EXPECT_TRUE(kExpected == Compress(kData));
+  std::string decompressed(kData.size(), 0);
+  EXPECT_TRUE(Decompress(kExpected, decompressed));
+  EXPECT_EQ(kData, decompressed);
+}
+
+TEST(Lz4Test, BEH_RoundTrip) {
+  std::string text;
+  while (text.size() < 300000)
+    text += "self-encrypting " + std::to_string(text.size() % 977) + " ";
+  std::vector<std::string> inputs{std::string(), "a", std::string(12, 'b'), std::string(13, 'b'),
+                                  std::string(100000, 'c'), RandomString(100000), text,
+                                  RandomString(70000) + text.substr(0, 70000)};
+  for (const auto& data : inputs) {
+    ByteVector compressed(Compress(data));
+    EXPECT_LE(compressed.size(), Lz4CompressBound(data.size()));
+    std::string decompressed(data.size(), 0);
+    EXPECT_TRUE(Decompress(compressed, decompressed)) << data.size();
+    EXPECT_TRUE(data == decompressed) << data.size();
+  }
+  EXPECT_LT(Compress(text).size(), text.size() / 4);
+}
+
+TEST(Lz4Test, BEH_RejectsMalformed) {
+  const std::string kData(std::string(1000, 'a') + RandomString(1000));
+  ByteVector compressed(Compress(kData));
+  std::string decompressed(kData.size(), 0);
+  ASSERT_TRUE(Decompress(compressed, decompressed));
+
+  // truncated input, or a different original size
+  ByteVector truncated(compressed.begin(), compressed.end() - 1);
+  EXPECT_FALSE(Decompress(truncated, decompressed));
+  std::string shorter(kData.size() - 1, 0), longer(kData.size() + 1, 0);
+  EXPECT_FALSE(Decompress(compressed, shorter));
+  EXPECT_FALSE(Decompress(compressed, longer));
+
+  // a match reaching back before the start of the output
+  const ByteVector kBadOffset{0x10, 'a', 0x02, 0x00, 0x50, 'a', 'a', 'a', 'a', 'a'};
+  std::string output(10, 0);
+  EXPECT_FALSE(Decompress(kBadOffset, output));
+  EXPECT_FALSE(Decompress(ByteVector(), output));
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -0,0 +1,146 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/pre_hash_tracker.h"
+
+#include <array>
+#include <string>
+
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+typedef std::array<byte, crypto::SHA512::DIGESTSIZE> Digest;
+
+Digest HashOf(const std::string& data) {
+  Digest digest;
+  CryptoPP::SHA512().CalculateDigest(digest.data(), reinterpret_cast<const byte*>(data.data()),
+                                     data.size());
+  return digest;
+}
+
+const byte* Bytes(const std::string& data, size_t offset = 0) {
+  return reinterpret_cast<const byte*>(data.data()) + offset;
+}
+
+}  // unnamed namespace
+
+TEST(PreHashTrackerTest, BEH_SequentialWrites) {
+  const uint32_t kPrefixLength(1000);
+  const uint64_t kChunkStart(5000);
+  std::string data(RandomString(3000));
+  Digest digest;
+
+  // in pieces crossing the end of the prefix
+  PreHashTracker tracker(kPrefixLength, EncryptionAlgorithm::kSelfEncryptionVersion0, 10);
+  for (uint32_t offset(0); offset < data.size(); offset += 300)
+    tracker.Write(Bytes(data, offset), 300, kChunkStart + offset, kChunkStart);
+  EXPECT_TRUE(tracker.Finish(kChunkStart, kChunkStart + data.size(), digest.data()));
+  EXPECT_TRUE(HashOf(data.substr(0, kPrefixLength)) == digest);
+  // the stream is discarded once finished
+  EXPECT_FALSE(tracker.Finish(kChunkStart, kChunkStart + data.size(), digest.data()));
+
+  // a chunk shorter than the prefix is hashed in full
+  tracker.Write(Bytes(data), 400, kChunkStart, kChunkStart);
+  EXPECT_FALSE(tracker.Finish(kChunkStart, kChunkStart + 401, digest.data()));
+  tracker.Write(Bytes(data), 400, kChunkStart, kChunkStart);
+  EXPECT_TRUE(tracker.Finish(kChunkStart, kChunkStart + 400, digest.data()));
+  EXPECT_TRUE(HashOf(data.substr(0, 400)) == digest);
+}
+
+TEST(PreHashTrackerTest, BEH_OutOfOrderWrites) {
+  const uint32_t kPrefixLength(1000);
+  std::string data(RandomString(2000));
+  Digest digest;
+  PreHashTracker tracker(kPrefixLength, EncryptionAlgorithm::kSelfEncryptionVersion0, 10);
+
+  // overwriting hashed bytes discards the stream
+  tracker.Write(Bytes(data), 500, 0, 0);
+  tracker.Write(Bytes(data, 100), 10, 100, 0);
+  tracker.Write(Bytes(data, 500), 500, 500, 0);
+  EXPECT_FALSE(tracker.Finish(0, data.size(), digest.data()));
+
+  // as does truncating them, but not writes or truncation beyond them
+  tracker.Write(Bytes(data), 500, 0, 0);
+  tracker.Write(Bytes(data, 1500), 10, 1500, 0);
+  tracker.Truncate(600);
+  tracker.Write(Bytes(data, 500), 500, 500, 0);
+  EXPECT_TRUE(tracker.Finish(0, data.size(), digest.data()));
+  EXPECT_TRUE(HashOf(data.substr(0, kPrefixLength)) == digest);
+  tracker.Write(Bytes(data), 500, 0, 0);
+  tracker.Truncate(499);
+  tracker.Write(Bytes(data, 499), 501, 499, 0);
+  EXPECT_FALSE(tracker.Finish(0, data.size(), digest.data()));
+
+  // a chunk not written from its start isn't tracked, nor is one with a gap
+  tracker.Write(Bytes(data, 1), 999, 1, 0);
+  EXPECT_FALSE(tracker.Finish(0, data.size(), digest.data()));
+  tracker.Write(Bytes(data), 100, 0, 0);
+  tracker.Write(Bytes(data, 200), 800, 200, 0);
+  EXPECT_FALSE(tracker.Finish(0, data.size(), digest.data()));
+
+  // a write starting where one chunk's stream ends leaves it intact, while one overlapping the next
+  // chunk's stream discards that
+  tracker.Write(Bytes(data), 1000, 0, 0);
+  tracker.Write(Bytes(data, 1000), 100, 1000, 1000);
+  tracker.Write(Bytes(data, 1050), 100, 1050, 1000);
+  EXPECT_TRUE(tracker.Finish(0, 1000, digest.data()));
+  EXPECT_FALSE(tracker.Finish(1000, 2000, digest.data()));
+}
+
+TEST(PreHashTrackerTest, BEH_LimitsLiveStreams) {
+  const uint32_t kPrefixLength(1000);
+  std::string data(RandomString(4 * kPrefixLength));
+  Digest digest;
+
+  // streams with complete prefixes keep only their digests, so don't count towards the limit
+  PreHashTracker tracker(kPrefixLength, EncryptionAlgorithm::kSelfEncryptionVersion0, 1);
+  for (uint32_t chunk(0); chunk != 4; ++chunk)
+    tracker.Write(Bytes(data, chunk * kPrefixLength), kPrefixLength, chunk * kPrefixLength,
+                  chunk * kPrefixLength);
+  for (uint32_t chunk(0); chunk != 4; ++chunk) {
+    EXPECT_TRUE(tracker.Finish(chunk * kPrefixLength, (chunk + 1) * kPrefixLength, digest.data()));
+    EXPECT_TRUE(HashOf(data.substr(chunk * kPrefixLength, kPrefixLength)) == digest);
+  }
+
+  // beyond the limit, the lowest incomplete streams are discarded
+  PreHashTracker limited(kPrefixLength, EncryptionAlgorithm::kSelfEncryptionVersion0, 2);
+  for (uint32_t chunk(0); chunk != 4; ++chunk)
+    limited.Write(Bytes(data, chunk * kPrefixLength), 500, chunk * kPrefixLength,
+                  chunk * kPrefixLength);
+  EXPECT_FALSE(limited.Finish(0, 500, digest.data()));
+  EXPECT_FALSE(limited.Finish(kPrefixLength, kPrefixLength + 500, digest.data()));
+  for (uint32_t chunk(2); chunk != 4; ++chunk) {
+    EXPECT_TRUE(limited.Finish(chunk * kPrefixLength, chunk * kPrefixLength + 500, digest.data()));
+    EXPECT_TRUE(HashOf(data.substr(chunk * kPrefixLength, 500)) == digest);
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
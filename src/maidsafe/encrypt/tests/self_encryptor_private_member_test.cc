@@ -29,8 +29,10 @@
 #include "maidsafe/common/data_buffer.h"
 
 #include "maidsafe/encrypt/self_encryptor.h"
+#include "maidsafe/encrypt/chunk_status_table.h"
 #include "maidsafe/encrypt/data_map.h"
 #include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/sequencer.h"
 #include "maidsafe/encrypt/tests/encrypt_test_base.h"
 
 namespace fs = boost::filesystem;
@@ -47,7 +49,7 @@ class PrivateSelfEncryptorTest : public EncryptTestBase, public testing::Test {
 
   uint64_t size() const { return self_encryptor_->file_size_; }
 
-  size_t ChunksSize() const { return self_encryptor_->chunks_.size(); }
+  size_t ChunksSize() const { return self_encryptor_->chunks_->size(); }
 
   uint32_t GetChunkSize(uint32_t chunk_num) const {
     return self_encryptor_->GetChunkSize(chunk_num);
@@ -72,6 +74,10 @@ class PrivateSelfEncryptorTest : public EncryptTestBase, public testing::Test {
   }
 
   void SetEncryptorSize(uint64_t size) { self_encryptor_->file_size_ = size; }
+
+  uint64_t ResidentSize(const SelfEncryptor& self_encryptor) const {
+    return self_encryptor.sequencer_->size();
+  }
 };
 
 TEST_F(PrivateSelfEncryptorTest, BEH_HelpersSmallfileContentOnly) {
@@ -219,6 +225,48 @@ TEST_F(PrivateSelfEncryptorTest, BEH_HelpersEqual5MaxChunks) {
   EXPECT_EQ(GetStartEndPositions(4).first, 4 * kMaxChunkSize);
   EXPECT_EQ(GetStartEndPositions(4).second, 5 * kMaxChunkSize);
 }
+
+TEST_F(PrivateSelfEncryptorTest, BEH_MemoryUsageCapped) {
+  const uint64_t kMaxMemoryUsage(8 * kMaxChunkSize);
+  DataMap data_map;
+  SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_,
+                               MemoryUsage(kMaxMemoryUsage));
+  const std::string content(RandomString(kMaxChunkSize / 4));
+  for (uint64_t position(0); position < 30 * kMaxChunkSize; position += content.size()) {
+    EXPECT_TRUE(self_encryptor.Write(content.data(), static_cast<uint32_t>(content.size()),
+                                     position));
+    EXPECT_LE(ResidentSize(self_encryptor), kMaxMemoryUsage);
+  }
+  self_encryptor.Close();
+  EXPECT_EQ(30, data_map.chunks.size());
+  for (const auto& chunk : data_map.chunks)
+    EXPECT_EQ(crypto::SHA512::DIGESTSIZE, chunk.hash.size());
+}
+
+TEST_F(PrivateSelfEncryptorTest, BEH_SparseWrite) {
+  const uint64_t kFileSize(1000 * kMaxChunkSize);
+  const std::string content(RandomString(kMinChunkSize));
+  EXPECT_TRUE(self_encryptor_->Write(content.data(), kMinChunkSize, kFileSize - kMinChunkSize));
+  EXPECT_EQ(kFileSize, size());
+  EXPECT_GE(8 * kMinChunkSize, ResidentSize(*self_encryptor_));
+
+  std::string hole(kMinChunkSize, 1);
+  EXPECT_TRUE(self_encryptor_->Read(&hole[0], kMinChunkSize, kFileSize / 2));
+  EXPECT_EQ(std::string(kMinChunkSize, 0), hole);
+  EXPECT_GE(8 * kMinChunkSize, ResidentSize(*self_encryptor_));
+  self_encryptor_->Close();
+
+  ASSERT_EQ(1000, data_map_.chunks.size());
+  for (uint32_t i(3); i != 998; ++i)
+    EXPECT_EQ(data_map_.chunks[2].hash, data_map_.chunks[i].hash);
+  self_encryptor_.reset(new SelfEncryptor(data_map_, local_store_, get_from_store_));
+  std::string result(kMinChunkSize, 0);
+  EXPECT_TRUE(self_encryptor_->Read(&hole[0], kMinChunkSize, kFileSize / 2));
+  EXPECT_EQ(std::string(kMinChunkSize, 0), hole);
+  EXPECT_TRUE(self_encryptor_->Read(&result[0], kMinChunkSize, kFileSize - kMinChunkSize));
+  EXPECT_EQ(content, result);
+}
+
 }  // namespace test
 
 }  // namespace encrypt
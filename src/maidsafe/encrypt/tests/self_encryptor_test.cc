@@ -18,7 +18,10 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdlib>
+#include <mutex>
+#include <numeric>
 #include <random>
 #include <string>
 #include <thread>
@@ -41,12 +44,17 @@
 #include "boost/scoped_array.hpp"
 #include "boost/shared_array.hpp"
 
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/make_unique.h"
 #include "maidsafe/common/test.h"
 #include "maidsafe/common/utils.h"
 
 #include "maidsafe/encrypt/self_encryptor.h"
+#include "maidsafe/encrypt/buffer_pool.h"
 #include "maidsafe/encrypt/data_map_encryptor.h"
 #include "maidsafe/encrypt/config.h"
 #include "maidsafe/encrypt/tests/encrypt_test_base.h"
@@ -1402,6 +1410,504 @@ TEST_F(BasicTest, FUNC_RandomAccess) {
   // be considered
 }
 
+TEST_F(BasicTest, FUNC_WriteAndReadWithMemoryCap) {
+  const MemoryUsage kMaxMemoryUsage(8 * kMaxChunkSize);
+  self_encryptor_->Close();
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_,
+                                                         kMaxMemoryUsage);
+  const uint32_t kPieceSize(65536);
+  for (uint32_t i(0); i < kDataSize_; i += kPieceSize)
+    ASSERT_TRUE(self_encryptor_->Write(&original_[i], kPieceSize, i));
+  // rewrite a few released chunks, including their first bytes which feed the pre-hashes
+  for (uint32_t position : {3 * kMaxChunkSize, 7 * kMaxChunkSize + 100, 2 * kMaxChunkSize - 10}) {
+    for (uint32_t i(0); i != kPieceSize; ++i)
+      original_[position + i] = ~original_[position + i];
+    ASSERT_TRUE(self_encryptor_->Write(&original_[position], kPieceSize, position));
+  }
+  for (uint32_t i(kDataSize_); i != 0; i -= kPieceSize)
+    ASSERT_TRUE(self_encryptor_->Read(&decrypted_[i - kPieceSize], kPieceSize, i - kPieceSize));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+  self_encryptor_->Close();
+
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_,
+                                                         kMaxMemoryUsage);
+  memset(decrypted_.get(), 1, kDataSize_);
+  for (uint32_t i(0); i < kDataSize_; i += kPieceSize)
+    ASSERT_TRUE(self_encryptor_->Read(&decrypted_[i], kPieceSize, i));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+}
+
+TEST_F(BasicTest, FUNC_WriteAndReadWithSpillFile) {
+  const fs::path kSpillDirectory(*test_dir_ / "spill");
+  ASSERT_TRUE(fs::create_directory(kSpillDirectory));
+  self_encryptor_->Close();
+  // the memory cap is left to the OS when spilling, so is far smaller than the file
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(
+      data_map_, local_store_, get_from_store_, MemoryUsage(4 * kMaxChunkSize), kSpillDirectory);
+  EXPECT_FALSE(fs::is_empty(kSpillDirectory));
+  const uint32_t kPieceSize(65536);
+  for (uint32_t i(0); i < kDataSize_; i += kPieceSize)
+    ASSERT_TRUE(self_encryptor_->Write(&original_[i], kPieceSize, i));
+  EXPECT_TRUE(self_encryptor_->data_map().chunks.empty());
+#ifdef __linux__
+  // the file space behind truncated data is released
+  const fs::path kSpillFile(fs::directory_iterator(kSpillDirectory)->path());
+  auto allocated([&] {
+    struct stat info;
+    EXPECT_EQ(0, stat(kSpillFile.string().c_str(), &info));
+    return static_cast<uint64_t>(info.st_blocks) * 512;
+  });
+  auto full_size(allocated());
+  EXPECT_GE(full_size, kDataSize_);
+  EXPECT_TRUE(self_encryptor_->Truncate(kDataSize_ / 2));
+  EXPECT_LT(allocated(), full_size - kDataSize_ / 4);
+#else
+  EXPECT_TRUE(self_encryptor_->Truncate(kDataSize_ / 2));
+#endif
+  EXPECT_TRUE(self_encryptor_->Truncate(kDataSize_));
+  memset(&original_[kDataSize_ / 2], 0, kDataSize_ / 2);
+  EXPECT_TRUE(self_encryptor_->Read(decrypted_.get(), kDataSize_, 0));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+  self_encryptor_->Close();
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_);
+  EXPECT_TRUE(fs::is_empty(kSpillDirectory));
+
+  memset(decrypted_.get(), 1, kDataSize_);
+  EXPECT_TRUE(self_encryptor_->Read(decrypted_.get(), kDataSize_, 0));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+}
+
+TEST_F(BasicTest, BEH_ScatterGatherWriteAndRead) {
+  // span lengths chosen to straddle chunk boundaries and to include an empty span
+  const std::vector<uint32_t> kSpanLengths = {1, kMaxChunkSize - 1, 0, 3 * kMaxChunkSize + 7,
+                                              4096, kDataSize_ - 4 * kMaxChunkSize - 4103};
+  std::vector<SelfEncryptor::ConstSpan> write_spans;
+  std::vector<SelfEncryptor::MutableSpan> read_spans;
+  std::vector<std::unique_ptr<char[]>> read_buffers;
+  uint32_t offset(0);
+  for (auto length : kSpanLengths) {
+    write_spans.push_back(SelfEncryptor::ConstSpan{&original_[offset], length});
+    read_buffers.emplace_back(new char[length + 1]);
+    read_spans.push_back(SelfEncryptor::MutableSpan{read_buffers.back().get(), length});
+    offset += length;
+  }
+  ASSERT_EQ(kDataSize_, offset);
+  EXPECT_TRUE(self_encryptor_->WriteV(write_spans.data(), write_spans.size(), 0));
+  EXPECT_EQ(kDataSize_, self_encryptor_->size());
+  EXPECT_TRUE(self_encryptor_->Read(decrypted_.get(), kDataSize_, 0));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+
+  self_encryptor_->Close();
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_);
+  EXPECT_FALSE(self_encryptor_->ReadV(read_spans.data(), read_spans.size(), 1));
+  EXPECT_TRUE(self_encryptor_->ReadV(read_spans.data(), read_spans.size(), 0));
+  offset = 0;
+  for (size_t i(0); i != kSpanLengths.size(); ++i) {
+    for (uint32_t j(0); j != kSpanLengths[i]; ++j, ++offset)
+      ASSERT_EQ(original_[offset], read_buffers[i][j]) << "difference at " << offset;
+  }
+}
+
+TEST_F(BasicTest, BEH_InjectedExecutor) {
+  std::atomic<int> task_count(0);
+  Executor inline_executor([&task_count](std::function<void()> task) {
+    ++task_count;
+    task();
+  });
+  const uint32_t kSize(10 * kMaxChunkSize);
+  self_encryptor_->Close();
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(
+      data_map_, local_store_, get_from_store_, MemoryUsage(kDefaultMaxMemoryUsage),
+      fs::path(), inline_executor);
+  EXPECT_TRUE(self_encryptor_->Write(original_.get(), kSize, 0));
+  self_encryptor_->Close();
+  EXPECT_NE(0, task_count);
+
+  task_count = 0;
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(
+      data_map_, local_store_, get_from_store_, MemoryUsage(kDefaultMaxMemoryUsage),
+      fs::path(), inline_executor);
+  EXPECT_TRUE(self_encryptor_->Read(decrypted_.get(), kSize, 0));
+  EXPECT_NE(0, task_count);
+  for (uint32_t i(0); i != kSize; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+}
+
+TEST_F(BasicTest, FUNC_SteadyStateBufferAllocations) {
+  // once the shared pool is warm, writing, closing and reading back further files allocates no
+  // more buffers, whether their pre-hashes are accumulated during writes or hashed by Close
+  const uint32_t kSize(8 * kMaxChunkSize + 1000), kPieceSize(65536);
+  auto write_and_read([&](EncryptionAlgorithm version, bool reversed) {
+    DataMap data_map;
+    data_map.self_encryption_version = version;
+    {
+      SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+      for (uint32_t i(0); i < kSize; i += kPieceSize) {
+        uint32_t position(reversed ? (kSize - 1) / kPieceSize * kPieceSize - i : i);
+        ASSERT_TRUE(self_encryptor.Write(&original_[position],
+                                         std::min(kPieceSize, kSize - position), position));
+      }
+      self_encryptor.Close();
+    }
+    SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+    ASSERT_TRUE(self_encryptor.Read(decrypted_.get(), kSize, 0));
+    self_encryptor.Close();
+  });
+  auto cycle([&] {
+    for (auto version : {EncryptionAlgorithm::kSelfEncryptionVersion0,
+                         EncryptionAlgorithm::kSelfEncryptionVersion1}) {
+      write_and_read(version, false);
+      write_and_read(version, true);
+    }
+  });
+  cycle();
+  auto allocations(BufferAllocations());
+  for (int i(0); i != 3; ++i)
+    cycle();
+  EXPECT_EQ(allocations, BufferAllocations());
+  for (uint32_t i(0); i != kSize; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+}
+
+TEST_F(BasicTest, FUNC_BackgroundEncryption) {
+  // the same writes, with and without background encryption and with a memory cap, must give the
+  // same DataMap
+  const uint32_t kPieceSize(65536);
+  const uint32_t kRewritePosition(5 * kMaxChunkSize + 100);
+  const MemoryUsage kSmallCap(8 * 1024 * 1024);
+  auto write([&](SelfEncryptor& self_encryptor) {
+    for (uint32_t i(0); i < kDataSize_; i += kPieceSize)
+      ASSERT_TRUE(self_encryptor.Write(&original_[i], kPieceSize, i));
+    ASSERT_TRUE(self_encryptor.Write(&original_[0], kPieceSize, kRewritePosition));
+  });
+  DataMap expected, background, background_capped;
+  {
+    SelfEncryptor self_encryptor(expected, local_store_, get_from_store_);
+    write(self_encryptor);
+    self_encryptor.Close();
+  }
+  {
+    std::atomic<int> task_count(0);
+    Executor counting_executor([&task_count](std::function<void()> task) {
+      ++task_count;
+      DefaultExecutor()(std::move(task));
+    });
+    SelfEncryptor self_encryptor(background, local_store_, get_from_store_,
+                                 MemoryUsage(kDefaultMaxMemoryUsage), fs::path(),
+                                 counting_executor);
+    self_encryptor.SetBackgroundEncryption(true);
+    write(self_encryptor);
+    EXPECT_NE(0, task_count);
+    self_encryptor.Close();
+  }
+  {
+    SelfEncryptor self_encryptor(background_capped, local_store_, get_from_store_, kSmallCap);
+    self_encryptor.SetBackgroundEncryption(true);
+    write(self_encryptor);
+    self_encryptor.Close();
+  }
+  EXPECT_TRUE(expected == background);
+  EXPECT_TRUE(expected == background_capped);
+
+  std::copy(&original_[0], &original_[kPieceSize], &original_[kRewritePosition]);
+  SelfEncryptor self_encryptor(background_capped, local_store_, get_from_store_);
+  EXPECT_TRUE(self_encryptor.Read(decrypted_.get(), kDataSize_, 0));
+  self_encryptor.Close();
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+}
+
+TEST_F(BasicTest, FUNC_SequentialWritePreHashes) {
+  // pre-hashes accumulated during sequential writes must match those calculated by Close, including
+  // for chunks partly overwritten afterwards or cut short by truncation
+  const uint32_t kPieceSize(4000);
+  const uint64_t kRewritePosition(4 * kMaxChunkSize + 10);
+  auto write([&](SelfEncryptor& self_encryptor, bool sequential) {
+    uint32_t pieces((kDataSize_ + kPieceSize - 1) / kPieceSize);
+    for (uint32_t i(0); i != pieces; ++i) {
+      uint32_t position((sequential ? i : pieces - 1 - i) * kPieceSize);
+      ASSERT_TRUE(self_encryptor.Write(&original_[position],
+                                       std::min(kPieceSize, kDataSize_ - position), position));
+    }
+    ASSERT_TRUE(self_encryptor.Write(&original_[0], 100, kRewritePosition));
+    ASSERT_TRUE(self_encryptor.Truncate(kDataSize_ - kMaxChunkSize - 20));
+    ASSERT_TRUE(self_encryptor.Truncate(kDataSize_));
+  });
+  for (auto version : {EncryptionAlgorithm::kSelfEncryptionVersion0,
+                       EncryptionAlgorithm::kSelfEncryptionVersion1}) {
+    DataMap sequential, reversed;
+    sequential.self_encryption_version = reversed.self_encryption_version = version;
+    {
+      SelfEncryptor self_encryptor(sequential, local_store_, get_from_store_);
+      write(self_encryptor, true);
+      self_encryptor.Close();
+    }
+    {
+      SelfEncryptor self_encryptor(reversed, local_store_, get_from_store_);
+      write(self_encryptor, false);
+      self_encryptor.Close();
+    }
+    EXPECT_TRUE(sequential == reversed) << "version " << static_cast<uint32_t>(version);
+  }
+}
+
+TEST_F(BasicTest, FUNC_CloseOverlapsHashingAndEncryption) {
+  // Version 1 and 2 pre-hashes cover whole chunks, so chunks written out of order are hashed by
+  // Close, with each chunk encrypted once its own and the two previous pre-hashes are ready rather
+  // than after all of them.  Run inline, the first chunks are encrypted before the last are hashed.
+  const uint32_t kSize(10 * kMaxChunkSize + 1000), kPieceSize(65536);
+  for (auto version : {EncryptionAlgorithm::kSelfEncryptionVersion1,
+                       EncryptionAlgorithm::kSelfEncryptionVersion2}) {
+    DataMap data_map;
+    data_map.self_encryption_version = version;
+    bool overlapped(false);
+    Executor inline_executor([&](std::function<void()> task) {
+      task();
+      bool encrypted(false), unhashed(false);
+      for (const auto& chunk : data_map.chunks) {
+        encrypted = encrypted || !chunk.hash.empty();
+        unhashed = unhashed || chunk.pre_hash.empty();
+      }
+      overlapped = overlapped || (encrypted && unhashed);
+    });
+    {
+      SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_,
+                                   MemoryUsage(kDefaultMaxMemoryUsage), fs::path(),
+                                   inline_executor);
+      for (uint32_t i(0); i < kSize; i += kPieceSize) {
+        uint32_t position((kSize - 1) / kPieceSize * kPieceSize - i);
+        ASSERT_TRUE(self_encryptor.Write(&original_[position],
+                                         std::min(kPieceSize, kSize - position), position));
+      }
+      self_encryptor.Close();
+    }
+    EXPECT_TRUE(overlapped) << "version " << static_cast<uint32_t>(version);
+
+    SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+    ASSERT_TRUE(self_encryptor.Read(decrypted_.get(), kSize, 0));
+    self_encryptor.Close();
+    for (uint32_t i(0); i != kSize; ++i)
+      ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+  }
+}
+
+TEST_F(BasicTest, FUNC_SelfEncryptionVersions) {
+  // each version and compression round-trips.  The first half of the data compresses while the
+  // rest doesn't, so from version 2 the latter's chunks are stored uncompressed whatever the
+  // compression.
+  const std::string kPattern(RandomString(1000));
+  for (uint32_t i(0); i != kDataSize_ / 2; ++i)
+    original_[i] = kPattern[i % kPattern.size()];
+  std::vector<DataMap> data_maps(4);
+  data_maps[1].self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion1;
+  data_maps[2].self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion2;
+  data_maps[3].self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion2;
+  data_maps[3].compression = ChunkCompression::kLz4;
+  for (auto& data_map : data_maps) {
+    {
+      SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+      EXPECT_TRUE(self_encryptor.Write(original_.get(), kDataSize_, 0));
+      self_encryptor.Close();
+    }
+    SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+    EXPECT_TRUE(self_encryptor.Read(decrypted_.get(), kDataSize_, 0));
+    self_encryptor.Close();
+    for (uint32_t i(0); i != kDataSize_; ++i)
+      ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+    EXPECT_TRUE(data_map.chunks.front().compressed);
+    EXPECT_EQ(data_map.self_encryption_version != EncryptionAlgorithm::kSelfEncryptionVersion2,
+              data_map.chunks.back().compressed);
+  }
+  EXPECT_EQ(EncryptionAlgorithm::kSelfEncryptionVersion1, data_maps[1].self_encryption_version);
+  EXPECT_EQ(ChunkCompression::kLz4, data_maps[3].compression);
+
+  // versions 1 and 2 only differ in the compression they allow, and version 0 in its hashing
+  EXPECT_TRUE(data_maps[1].chunks.front().hash == data_maps[2].chunks.front().hash);
+  EXPECT_FALSE(data_maps[1].chunks.back().hash == data_maps[2].chunks.back().hash);
+  EXPECT_FALSE(data_maps[0].chunks.front().hash == data_maps[1].chunks.front().hash);
+  EXPECT_FALSE(data_maps[0].chunks.back().hash == data_maps[1].chunks.back().hash);
+  EXPECT_FALSE(data_maps[2].chunks.front().hash == data_maps[3].chunks.front().hash);
+  EXPECT_TRUE(data_maps[2].chunks.back().hash == data_maps[3].chunks.back().hash);
+
+  // a DataMap of any other version, or with compression its version doesn't allow, is rejected
+  DataMap unknown;
+  unknown.self_encryption_version = EncryptionAlgorithm::kDataMapEncryptionVersion0;
+  EXPECT_THROW(SelfEncryptor self_encryptor(unknown, local_store_, get_from_store_),
+               maidsafe_error);
+  unknown.self_encryption_version = EncryptionAlgorithm::kSelfEncryptionVersion1;
+  unknown.compression = ChunkCompression::kLz4;
+  EXPECT_THROW(SelfEncryptor self_encryptor(unknown, local_store_, get_from_store_),
+               maidsafe_error);
+}
+
+TEST_F(BasicTest, FUNC_CompressionPolicy) {
+  // a higher fixed level gives smaller chunks than the default, and an adaptive policy may mix
+  // levels, but all decrypt the same way
+  const std::string kPattern(RandomString(1000) + std::string(1000, 'a'));
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    original_[i] = kPattern[i % kPattern.size()];
+  std::vector<std::shared_ptr<CompressionPolicy>> policies{
+      std::make_shared<CompressionPolicy>(), std::make_shared<CompressionPolicy>(9),
+      std::make_shared<CompressionPolicy>(1000 * 1000, Concurrency())};
+  std::vector<DataMap> data_maps(policies.size());
+  for (size_t i(0); i != policies.size(); ++i) {
+    {
+      SelfEncryptor self_encryptor(data_maps[i], local_store_, get_from_store_);
+      EXPECT_THROW(self_encryptor.SetCompressionPolicy(nullptr), maidsafe_error);
+      self_encryptor.SetCompressionPolicy(policies[i]);
+      EXPECT_TRUE(self_encryptor.Write(original_.get(), kDataSize_, 0));
+      self_encryptor.Close();
+    }
+    SelfEncryptor self_encryptor(data_maps[i], local_store_, get_from_store_);
+    EXPECT_TRUE(self_encryptor.Read(decrypted_.get(), kDataSize_, 0));
+    self_encryptor.Close();
+    for (uint32_t j(0); j != kDataSize_; ++j)
+      ASSERT_EQ(original_[j], decrypted_[j]) << "difference at " << j;
+  }
+  EXPECT_FALSE(data_maps[0].chunks[2].hash == data_maps[1].chunks[2].hash);
+  auto stored_size([&](const DataMap& data_map) {
+    const ChunkDigest& name(data_map.chunks[2].hash);
+    return get_from_store_(std::string(name.begin(), name.end())).string().size();
+  });
+  EXPECT_LT(stored_size(data_maps[1]), stored_size(data_maps[0]));
+}
+
+TEST_F(BasicTest, FUNC_ConcurrentReads) {
+  EXPECT_TRUE(self_encryptor_->Write(original_.get(), kDataSize_, 0));
+  self_encryptor_->Close();
+  // a small cap so that some reads need chunks loading while others are running
+  self_encryptor_ = maidsafe::make_unique<SelfEncryptor>(data_map_, local_store_, get_from_store_,
+                                                         MemoryUsage(8 * 1024 * 1024));
+  const uint32_t kReadSize(100000);
+  std::vector<std::thread> readers;
+  std::atomic<int> failures(0);
+  for (int i(0); i != 8; ++i) {
+    readers.emplace_back([&, i] {
+      std::unique_ptr<char[]> buffer(new char[kReadSize]);
+      for (uint32_t position(i * kReadSize); position + kReadSize <= kDataSize_;
+           position += 8 * kReadSize) {
+        if (!self_encryptor_->Read(buffer.get(), kReadSize, position) ||
+            !std::equal(buffer.get(), buffer.get() + kReadSize, &original_[position])) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto& reader : readers)
+    reader.join();
+  EXPECT_EQ(0, failures);
+}
+
+TEST_F(BasicTest, FUNC_BatchedRetrieval) {
+  EXPECT_TRUE(self_encryptor_->Write(original_.get(), kDataSize_, 0));
+  self_encryptor_->Close();
+
+  // each batch is retrieved on its own thread, in reverse order
+  std::mutex mutex;
+  std::vector<std::thread> fetchers;
+  std::vector<size_t> batch_sizes;
+  GetChunksFromStore get_chunks([&](const std::vector<std::string>& names,
+                                    ChunkRetrieved on_retrieved) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch_sizes.push_back(names.size());
+    fetchers.emplace_back([=] {
+      for (size_t i(names.size()); i != 0; --i)
+        on_retrieved(i - 1, std::exception_ptr(), get_from_store_(names[i - 1]));
+    });
+  });
+  {
+    SelfEncryptor self_encryptor(data_map_, local_store_, get_chunks);
+    EXPECT_TRUE(self_encryptor.Read(decrypted_.get(), kDataSize_, 0));
+    self_encryptor.Close();
+  }
+  for (auto& fetcher : fetchers)
+    fetcher.join();
+  for (uint32_t i(0); i != kDataSize_; ++i)
+    ASSERT_EQ(original_[i], decrypted_[i]) << "difference at " << i;
+  ASSERT_FALSE(batch_sizes.empty());
+  EXPECT_EQ(3U, batch_sizes.front());
+  EXPECT_EQ(data_map_.chunks.size(),
+            std::accumulate(std::begin(batch_sizes), std::end(batch_sizes), size_t(0)));
+}
+
+TEST_F(BasicTest, FUNC_SequentialReadAhead) {
+  const uint32_t kFileSize(20 * kMaxChunkSize), kReadSize(64 * 1024);
+  const std::string expected(RandomString(kFileSize));
+  EXPECT_TRUE(self_encryptor_->Write(expected.data(), kFileSize, 0));
+  self_encryptor_->Close();
+  ASSERT_EQ(20U, data_map_.chunks.size());
+
+  std::atomic<int> fetches(0);
+  auto counting_get([&](const std::string& name) {
+    ++fetches;
+    return get_from_store_(name);
+  });
+
+  // sequential reads of the first three chunks load chunks beyond them too
+  std::string actual(kReadSize, 0);
+  {
+    SelfEncryptor self_encryptor(data_map_, local_store_, counting_get,
+                                 MemoryUsage(32 * kMaxChunkSize));
+    for (uint32_t position(0); position != 3 * kMaxChunkSize; position += kReadSize) {
+      ASSERT_TRUE(self_encryptor.Read(&actual[0], kReadSize, position));
+      ASSERT_EQ(expected.substr(position, kReadSize), actual);
+    }
+    self_encryptor.Close();
+  }
+  EXPECT_GT(fetches, 3);
+
+  // reading the rest sequentially fetches each chunk once only
+  fetches = 0;
+  {
+    SelfEncryptor self_encryptor(data_map_, local_store_, counting_get,
+                                 MemoryUsage(32 * kMaxChunkSize));
+    for (uint32_t position(0); position != kFileSize; position += kReadSize) {
+      ASSERT_TRUE(self_encryptor.Read(&actual[0], kReadSize, position));
+      ASSERT_EQ(expected.substr(position, kReadSize), actual);
+    }
+    self_encryptor.Close();
+  }
+  EXPECT_EQ(20, fetches);
+
+  // random access reads nothing ahead
+  fetches = 0;
+  {
+    SelfEncryptor self_encryptor(data_map_, local_store_, counting_get,
+                                 MemoryUsage(32 * kMaxChunkSize));
+    for (uint32_t chunk : {15U, 10U, 5U, 12U}) {
+      uint32_t position(chunk * kMaxChunkSize + kReadSize);
+      ASSERT_TRUE(self_encryptor.Read(&actual[0], kReadSize, position));
+      ASSERT_EQ(expected.substr(position, kReadSize), actual);
+    }
+    self_encryptor.Close();
+  }
+  EXPECT_EQ(3 + 4, fetches);
+}
+
+TEST_F(BasicTest, FUNC_ReadShortLastChunk) {
+  // the penultimate chunk is shortened to keep the last at least kMinChunkSize
+  self_encryptor_->Close();
+  for (uint32_t size : {3 * kMaxChunkSize + 1, 4 * kMaxChunkSize + kMinChunkSize - 1}) {
+    const std::string expected(RandomString(size));
+    DataMap data_map;
+    {
+      SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+      EXPECT_TRUE(self_encryptor.Write(expected.data(), size, 0));
+      self_encryptor.Close();
+    }
+    std::string actual(size, 0);
+    SelfEncryptor self_encryptor(data_map, local_store_, get_from_store_);
+    EXPECT_TRUE(self_encryptor.Read(&actual[0], size, 0));
+    EXPECT_TRUE(expected == actual) << size;
+    self_encryptor.Close();
+  }
+}
+
 TEST_F(BasicTest, FUNC_ReadAfterClose) {
   const std::size_t read_size = 104857;               // 0.1MB
   const std::string expected(RandomString(8388608));  // 8MB
@@ -0,0 +1,76 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/sha512_batch.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+#ifdef __MSVC__
+#pragma warning(push, 1)
+#endif
+#include "cryptopp/sha.h"
+#ifdef __MSVC__
+#pragma warning(pop)
+#endif
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+TEST(Sha512BatchTest, BEH_MatchesCryptoPP) {
+  // lengths either side of where the padding spills into a second block, and a mix of short and
+  // long messages so that lanes finish at different times
+  std::vector<std::string> messages;
+  for (size_t length : {0, 1, 64, 111, 112, 127, 128, 129, 239, 240, 256, 1000, 100000, 3, 70000})
+    messages.push_back(RandomString(length));
+  std::vector<std::array<byte, crypto::SHA512::DIGESTSIZE>> expected(messages.size());
+  for (size_t i(0); i != messages.size(); ++i) {
+    CryptoPP::SHA512().CalculateDigest(expected[i].data(),
+                                       reinterpret_cast<const byte*>(messages[i].data()),
+                                       messages[i].size());
+  }
+
+  for (int i(0); i <= static_cast<int>(BestSha512Implementation()); ++i) {
+    Sha512Implementation implementation(static_cast<Sha512Implementation>(i));
+    SCOPED_TRACE(Sha512ImplementationName(implementation));
+    for (size_t count : {size_t(0), size_t(1), Sha512Lanes(implementation), messages.size()}) {
+      std::vector<std::array<byte, crypto::SHA512::DIGESTSIZE>> digests(count);
+      std::vector<HashJob> jobs;
+      for (size_t j(0); j != count; ++j) {
+        jobs.push_back(HashJob{reinterpret_cast<const byte*>(messages[j].data()),
+                               messages[j].size(), digests[j].data()});
+      }
+      Sha512Batch(jobs.data(), jobs.size(), implementation);
+      for (size_t j(0); j != count; ++j)
+        EXPECT_TRUE(expected[j] == digests[j]) << "message " << j << " of " << count;
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
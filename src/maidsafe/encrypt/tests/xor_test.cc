@@ -0,0 +1,89 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+#include "maidsafe/encrypt/config.h"
+#include "maidsafe/encrypt/xor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace test {
+
+namespace {
+
+ByteVector RandomBytes(size_t size) {
+  std::string random(RandomString(size));
+  return ByteVector(random.begin(), random.end());
+}
+
+}  // unnamed namespace
+
+TEST(XorTest, BEH_XorWithPadMatchesBytewise) {
+  for (size_t pad_size : {kPadSize, size_t(crypto::SHA512::DIGESTSIZE), size_t(1), size_t(33)}) {
+    ByteVector pad(RandomBytes(pad_size)), in(RandomBytes(4 * kPadSize + 37));
+    for (size_t length : {size_t(0), size_t(1), size_t(15), size_t(31), size_t(32), kPadSize,
+                          in.size()}) {
+      for (size_t pad_offset : {size_t(0), size_t(1), pad_size / 2, pad_size - 1}) {
+        ByteVector expected(length), actual(length);
+        for (size_t i(0); i != length; ++i)
+          expected[i] = in[i] ^ pad[(pad_offset + i) % pad_size];
+        XorWithPad(in.data(), actual.data(), length, pad.data(), pad_size, pad_offset);
+        EXPECT_TRUE(expected == actual) << pad_size << " " << length << " " << pad_offset;
+        // in place
+        ByteVector in_place(in.begin(), in.begin() + length);
+        XorWithPad(in_place.data(), in_place.data(), length, pad.data(), pad_size, pad_offset);
+        EXPECT_TRUE(expected == in_place) << pad_size << " " << length << " " << pad_offset;
+      }
+    }
+  }
+}
+
+TEST(XorTest, BEH_XorFilterAcrossPuts) {
+  ByteVector pad(RandomBytes(kPadSize)), in(RandomBytes(1000));
+  std::string expected;
+  for (size_t i(0); i != in.size(); ++i)
+    expected.push_back(static_cast<char>(in[i] ^ pad[i % kPadSize]));
+
+  // the position in the pad carries over between pieces of arbitrary sizes
+  std::string actual;
+  XORFilter filter(new CryptoPP::StringSink(actual), pad.data());
+  size_t position(0), piece(1);
+  while (position != in.size()) {
+    size_t length(std::min(piece, in.size() - position));
+    filter.Put(in.data() + position, length);
+    position += length;
+    piece = piece * 3 + 1;
+  }
+  filter.MessageEnd();
+  EXPECT_EQ(expected, actual);
+}
+
+}  // namespace test
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
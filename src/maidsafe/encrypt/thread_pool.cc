@@ -0,0 +1,230 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "boost/exception/diagnostic_information.hpp"
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+Executor DefaultExecutor() {
+  static ThreadPool pool(static_cast<unsigned>(std::max(Concurrency(), 1)));
+  return [](std::function<void()> task) { pool.Post(std::move(task)); };
+}
+
+namespace {
+
+// The pool and queue index of the current thread, if it is a worker
+thread_local const ThreadPool* g_current_pool(nullptr);
+thread_local size_t g_current_queue(0);
+
+}  // unnamed namespace
+
+ThreadPool::ThreadPool(unsigned thread_count)
+    : queues_(), queued_(0), next_queue_(0), stopping_(false), mutex_(), condition_(),
+      threads_() {
+  for (unsigned i(0); i != std::max(thread_count, 1U); ++i)
+    queues_.emplace_back(new Queue);
+  for (size_t i(0); i != queues_.size(); ++i)
+    threads_.emplace_back([this, i] { Run(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+void ThreadPool::Post(std::function<void()> task) {
+  size_t index(g_current_pool == this ? g_current_queue : next_queue_++ % queues_.size());
+  {
+    // counted under mutex_ so that a worker about to sleep can't miss the task
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++queued_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void ThreadPool::Run(size_t index) {
+  g_current_pool = this;
+  g_current_queue = index;
+  for (;;) {
+    std::function<void()> task;
+    if (!Pop(index, task)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || queued_ != 0; });
+      if (queued_ == 0)
+        return;
+      continue;
+    }
+    try {
+      task();
+    } catch (const std::exception& e) {
+      LOG(kError) << "Task threw: " << boost::diagnostic_information(e);
+    }
+  }
+}
+
+bool ThreadPool::Pop(size_t index, std::function<void()>& task) {
+  for (size_t i(0); i != queues_.size(); ++i) {
+    Queue& queue(*queues_[(index + i) % queues_.size()]);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    --queued_;
+    return true;
+  }
+  return false;
+}
+
+TaskGroup::TaskGroup(const Executor& executor, unsigned max_parallel)
+    : kMaxParallel_(std::max(max_parallel, 1U)), state_(std::make_shared<State>(executor)) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    Wait();
+  } catch (const std::exception& e) {
+    LOG(kWarning) << boost::diagnostic_information(e);
+  }
+}
+
+void TaskGroup::Run(std::function<void()> task) {
+  bool post(false);
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->tasks.push_back(std::move(task));
+    if (state_->posted < kMaxParallel_) {
+      ++state_->posted;
+      post = true;
+    }
+  }
+  if (post) {
+    auto state(state_);
+    state_->executor([state] { RunNext(state); });
+  }
+}
+
+void TaskGroup::AddPending(unsigned count) {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  state_->pending += count;
+}
+
+void TaskGroup::RemovePending() {
+  // notify under the lock, since once Wait can return, the group may be destroyed
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  assert(state_->pending != 0);
+  --state_->pending;
+  state_->condition.notify_all();
+}
+
+void TaskGroup::Wait() {
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  for (;;) {
+    if (!state_->tasks.empty()) {
+      // rather than wait for the executor, run the task here
+      auto task(std::move(state_->tasks.front()));
+      state_->tasks.pop_front();
+      ++state_->running;
+      lock.unlock();
+      try {
+        task();
+      } catch (...) {
+        lock.lock();
+        if (!state_->exception)
+          state_->exception = std::current_exception();
+        lock.unlock();
+      }
+      lock.lock();
+      --state_->running;
+    } else if (state_->running != 0 || state_->pending != 0) {
+      // runners still held by the executor but not yet started need not be waited for; they'll
+      // find no tasks left
+      state_->condition.wait(lock);
+    } else {
+      break;
+    }
+  }
+  if (state_->exception) {
+    std::exception_ptr exception;
+    std::swap(exception, state_->exception);
+    std::rethrow_exception(exception);
+  }
+}
+
+void TaskGroup::RunNext(const std::shared_ptr<State>& state) {
+  std::function<void()> task;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->tasks.empty()) {
+      --state->posted;
+      return;
+    }
+    task = std::move(state->tasks.front());
+    state->tasks.pop_front();
+    ++state->running;
+  }
+  std::exception_ptr exception;
+  try {
+    task();
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  bool repost(false);
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (exception && !state->exception)
+      state->exception = exception;
+    --state->running;
+    if (state->tasks.empty())
+      --state->posted;
+    else
+      repost = true;
+  }
+  state->condition.notify_all();
+  if (repost)
+    state->executor([state] { RunNext(state); });
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
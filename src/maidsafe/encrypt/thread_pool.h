@@ -0,0 +1,123 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_ENCRYPT_THREAD_POOL_H_
+#define MAIDSAFE_ENCRYPT_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/encrypt/executor.h"
+
+namespace maidsafe {
+
+namespace encrypt {
+
+// Fixed number of worker threads, each with its own queue of tasks.  Tasks posted by a worker go
+// to the back of its own queue, so follow-on work stays on the thread which produced it, while
+// tasks posted from elsewhere are spread round the queues.  A worker takes the newest task from its
+// own queue, whose data is the most likely to still be in its cache, and when that is empty steals
+// the oldest from the front of another's before sleeping, so that owner and thief work from
+// opposite ends.  Outstanding tasks are completed before destruction.
+class ThreadPool {
+ public:
+  explicit ThreadPool(unsigned thread_count);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool) = delete;
+
+  void Post(std::function<void()> task);
+
+ private:
+  struct Queue {
+    Queue() : tasks(), mutex() {}
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+  };
+
+  void Run(size_t index);
+  // Takes the next task from the back of the worker's own queue, or else from the front of another
+  bool Pop(size_t index, std::function<void()>& task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::atomic<size_t> queued_, next_queue_;
+  bool stopping_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<std::thread> threads_;
+};
+
+// Runs a batch of tasks via an Executor, keeping at most "max_parallel" of them with the Executor
+// at any time so that a large batch cannot crowd out other users of a shared pool.  Tasks not yet
+// handed to the Executor are run by the thread calling Wait, so waiting from one of the Executor's
+// own threads cannot deadlock.
+class TaskGroup {
+ public:
+  TaskGroup(const Executor& executor, unsigned max_parallel);
+  // Waits for all tasks, ignoring any exception
+  ~TaskGroup();
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup(TaskGroup&&) = delete;
+  TaskGroup& operator=(TaskGroup) = delete;
+
+  void Run(std::function<void()> task);
+  // Registers "count" operations completing outside the group (e.g. network fetches) which Wait
+  // should also wait for.  Each must be matched by a call to RemovePending.
+  void AddPending(unsigned count);
+  void RemovePending();
+  // Blocks until all tasks and pending operations have completed, then rethrows the first exception
+  // thrown by any task
+  void Wait();
+
+ private:
+  struct State {
+    explicit State(const Executor& executor_in)
+        : executor(executor_in), tasks(), posted(0), running(0), pending(0), exception(), mutex(),
+          condition() {}
+    const Executor executor;
+    std::deque<std::function<void()>> tasks;
+    unsigned posted, running;  // runners currently held by the executor, and tasks executing
+    unsigned pending;
+    std::exception_ptr exception;
+    std::mutex mutex;
+    std::condition_variable condition;
+  };
+
+  // Executed via the Executor; runs the next queued task, then hands itself back to the Executor
+  // if more remain, so that the threads are shared in turn with other groups
+  static void RunNext(const std::shared_ptr<State>& state);
+
+  const unsigned kMaxParallel_;
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_ENCRYPT_THREAD_POOL_H_
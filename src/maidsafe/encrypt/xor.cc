@@ -0,0 +1,141 @@
+/*  Copyright 2011 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/encrypt/xor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#ifdef __SSE2__
+#define MAIDSAFE_ENCRYPT_XOR_SSE2 1
+#endif
+#define MAIDSAFE_ENCRYPT_XOR_AVX2 1
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define MAIDSAFE_ENCRYPT_XOR_SSE2 1
+#define MAIDSAFE_ENCRYPT_XOR_AVX2 1
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace maidsafe {
+
+namespace encrypt {
+
+namespace {
+
+// Each kernel sets out[i] = in[i] ^ pad[i] for i in [0, length)
+typedef void (*XorKernel)(const byte* in, byte* out, const byte* pad, size_t length);
+
+void XorScalar(const byte* in, byte* out, const byte* pad, size_t length) {
+  size_t i(0);
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t data, mask;
+    std::memcpy(&data, in + i, sizeof(data));
+    std::memcpy(&mask, pad + i, sizeof(mask));
+    data ^= mask;
+    std::memcpy(out + i, &data, sizeof(data));
+  }
+  for (; i != length; ++i)
+    out[i] = in[i] ^ pad[i];
+}
+
+#ifdef MAIDSAFE_ENCRYPT_XOR_SSE2
+void XorSse2(const byte* in, byte* out, const byte* pad, size_t length) {
+  size_t i(0);
+  for (; i + 16 <= length; i += 16) {
+    __m128i data(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+    __m128i mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pad + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(data, mask));
+  }
+  XorScalar(in + i, out + i, pad + i, length - i);
+}
+#endif
+
+#ifdef MAIDSAFE_ENCRYPT_XOR_AVX2
+#ifdef __GNUC__
+__attribute__((target("avx2")))
+#endif
+void XorAvx2(const byte* in, byte* out, const byte* pad, size_t length) {
+  size_t i(0);
+  for (; i + 32 <= length; i += 32) {
+    __m256i data(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)));
+    __m256i mask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pad + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(data, mask));
+  }
+  for (; i + 16 <= length; i += 16) {
+    __m128i data(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+    __m128i mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pad + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(data, mask));
+  }
+  XorScalar(in + i, out + i, pad + i, length - i);
+}
+
+bool HasAvx2() {
+#ifdef __GNUC__
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#else
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  // the OS must save the YMM registers too
+  const int kOsxsaveAndAvx((1 << 27) | (1 << 28));
+  if ((info[2] & kOsxsaveAndAvx) != kOsxsaveAndAvx || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+XorKernel SelectKernel() {
+#ifdef MAIDSAFE_ENCRYPT_XOR_AVX2
+  if (HasAvx2())
+    return XorAvx2;
+#endif
+#ifdef MAIDSAFE_ENCRYPT_XOR_SSE2
+  return XorSse2;
+#else
+  return XorScalar;
+#endif
+}
+
+}  // unnamed namespace
+
+void XorWithPad(const byte* in, byte* out, size_t length, const byte* pad, size_t pad_size,
+                size_t pad_offset) {
+  static const XorKernel kernel(SelectKernel());
+  // the pad is contiguous within each period, so each period is a single kernel call
+  while (length != 0) {
+    size_t count(std::min(length, pad_size - pad_offset));
+    kernel(in, out, pad + pad_offset, count);
+    in += count;
+    out += count;
+    length -= count;
+    pad_offset = 0;
+  }
+}
+
+}  // namespace encrypt
+
+}  // namespace maidsafe
@@ -23,6 +23,8 @@
 #include <omp.h>
 #endif
 
+#include <cstddef>
+#include <vector>
 
 #ifdef __MSVC__
 #pragma warning(push, 1)
@@ -33,6 +35,9 @@
 #pragma warning(pop)
 #endif
 
+#include "maidsafe/common/crypto.h"
+#include "maidsafe/common/types.h"
+
 
 namespace maidsafe {
 
@@ -41,10 +46,16 @@ namespace encrypt {
 const size_t kPadSize((3 * crypto::SHA512::DIGESTSIZE) - crypto::AES256_KeySize -
                       crypto::AES256_IVSize);
 
+// Sets out[i] = in[i] ^ pad[(pad_offset + i) % pad_size] for each of the "length" bytes.  The pad
+// is applied a period at a time using the widest vector instructions the CPU supports, chosen at
+// runtime.  "in" and "out" may be the same.
+void XorWithPad(const byte* in, byte* out, size_t length, const byte* pad, size_t pad_size,
+                size_t pad_offset);
+
 class XORFilter : public CryptoPP::Bufferless<CryptoPP::Filter> {
  public:
   XORFilter(CryptoPP::BufferedTransformation* attachment, byte* pad, size_t pad_size = kPadSize)
-      : pad_(pad), count_(0), kPadSize_(pad_size) {
+      : pad_(pad), pad_offset_(0), kPadSize_(pad_size), buffer_() {
     CryptoPP::Filter::Detach(attachment);
   }
   XORFilter& operator=(const XORFilter&) = delete;
@@ -54,22 +65,21 @@ class XORFilter : public CryptoPP::Bufferless<CryptoPP::Filter> {
     if (length == 0) {
       return AttachedTransformation()->Put2(in_string, length, message_end, blocking);
     }
-    std::unique_ptr<byte[]> buffer(new byte[length]);
+    if (buffer_.size() < length)
+      buffer_.resize(length);
 
-    size_t i(0);
-    for (; i != length; ++i) {
-      buffer[i] = in_string[i] ^ pad_[count_ % kPadSize_];
-      ++count_;
-    }
+    XorWithPad(in_string, buffer_.data(), length, pad_, kPadSize_, pad_offset_);
+    pad_offset_ = (pad_offset_ + length) % kPadSize_;
 
-    return AttachedTransformation()->Put2(buffer.get(), length, message_end, blocking);
+    return AttachedTransformation()->Put2(buffer_.data(), length, message_end, blocking);
   }
   bool IsolatedFlush(bool, bool) override { return false; }
 
  private:
   byte* pad_;
-  size_t count_;
+  size_t pad_offset_;
   const size_t kPadSize_;
+  std::vector<byte> buffer_;  // reused between calls
 };
 }  // namespace encrypt
 